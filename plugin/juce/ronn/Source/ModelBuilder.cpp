@@ -0,0 +1,98 @@
+/*
+  ==============================================================================
+
+    ModelBuilder.cpp
+
+  ==============================================================================
+*/
+
+#include "ModelBuilder.h"
+
+//==============================================================================
+ModelBuilder::ModelBuilder (Factory factory)
+    : Thread ("ronn model builder"), createModel (factory)
+{
+    startThread();
+}
+
+ModelBuilder::~ModelBuilder()
+{
+    stopThread (2000);
+    collectRetiredModels();
+    delete readyModel.exchange (nullptr);
+}
+
+//==============================================================================
+void ModelBuilder::requestBuild()
+{
+    lastRequestTime = Time::getMillisecondCounter();
+    buildRequested = true;
+}
+
+Model* ModelBuilder::takeModel()
+{
+    return readyModel.exchange (nullptr);
+}
+
+void ModelBuilder::retireModel (Model* oldModel)
+{
+    int start1, size1, start2, size2;
+    retireFifo.prepareToWrite (1, start1, size1, start2, size2);
+
+    if (size1 == 0)
+    {
+        // the builder thread drains this every few milliseconds and the audio
+        // thread retires at most one model per crossfade, so this should never happen
+        jassertfalse;
+        delete oldModel;
+        return;
+    }
+
+    retiredModels[start1] = oldModel;
+    retireFifo.finishedWrite (1);
+}
+
+//==============================================================================
+void ModelBuilder::run()
+{
+    while (! threadShouldExit())
+    {
+        wait (10);
+        collectRetiredModels();
+
+        if (! buildRequested.load())
+            continue;
+
+        // wait for the parameters to settle before spending time on a build
+        if (Time::getMillisecondCounter() - lastRequestTime.load() < (uint32) settleTimeMs)
+            continue;
+
+        buildRequested = false;
+        auto newModel = createModel (std::move (spareModel));
+
+        // parameters moved again while we were building, so this one is already stale
+        if (buildRequested.load())
+        {
+            spareModel = std::move (newModel);
+            continue;
+        }
+
+        // replace any model the audio thread has not picked up yet, it becomes the spare
+        if (auto* staleModel = readyModel.exchange (newModel.release()))
+            spareModel.reset (staleModel);
+    }
+}
+
+void ModelBuilder::collectRetiredModels()
+{
+    int start1, size1, start2, size2;
+    retireFifo.prepareToRead (retireFifo.getNumReady(), start1, size1, start2, size2);
+
+    // the latest one is kept for the next build, the others are destroyed here
+    for (int i = 0; i < size1; ++i)
+        spareModel.reset (retiredModels[start1 + i]);
+    for (int i = 0; i < size2; ++i)
+        spareModel.reset (retiredModels[start2 + i]);
+
+    retireFifo.finishedRead (size1 + size2);
+}
@@ -0,0 +1,59 @@
+/*
+  ==============================================================================
+
+    ModelBuilder.h
+
+    Builds new models on a background thread and hands them to the audio
+    thread without locks, collecting the models it replaces so that they
+    are destroyed off the audio thread as well, or reused by the next build.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+#include "ronnlib.h"
+
+//==============================================================================
+class ModelBuilder  : private Thread
+{
+public:
+    // creates a fully prepared model from the current parameters, always called on
+    // the builder thread. spare is the last model the audio thread gave back (or
+    // nullptr), which the factory may reuse when only its weights have to change
+    typedef std::function<std::unique_ptr<Model> (std::unique_ptr<Model> spare)> Factory;
+
+    explicit ModelBuilder (Factory factory);
+    ~ModelBuilder();
+
+    // any thread (including the audio thread), lock-free
+    void requestBuild();
+
+    // audio thread, wait-free: returns the latest finished model or nullptr
+    Model* takeModel();
+
+    // audio thread, wait-free: hands back a model that is no longer used
+    void retireModel (Model* oldModel);
+
+    // how long the parameters have to stay put before a build starts,
+    // so a slider drag only causes a single rebuild
+    int settleTimeMs = 100;
+
+private:
+    void run() override;
+    void collectRetiredModels();
+
+    Factory createModel;
+
+    std::atomic<bool> buildRequested { false };
+    std::atomic<uint32> lastRequestTime { 0 };
+    std::atomic<Model*> readyModel { nullptr };
+
+    enum { retireCapacity = 32 };
+    AbstractFifo retireFifo { retireCapacity };
+    Model* retiredModels[retireCapacity];
+    std::unique_ptr<Model> spareModel;      // builder thread only
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (ModelBuilder)
+};
@@ -0,0 +1,67 @@
+/*
+  ==============================================================================
+
+    ModelCache.cpp
+
+  ==============================================================================
+*/
+
+#include "ModelCache.h"
+
+//==============================================================================
+bool ModelCache::Key::operator== (const Key& other) const
+{
+    return model == other.model && checksum == other.checksum
+        && eco == other.eco && precision == other.precision;
+}
+
+//==============================================================================
+std::shared_ptr<Model> ModelCache::getModel (const Key& key, const Factory& factory)
+{
+    auto find = [this, &key] () -> std::shared_ptr<Model>
+    {
+        for (auto it = entries.begin(); it != entries.end(); ++it)
+        {
+            if (it->key == key)
+            {
+                entries.splice (entries.begin(), entries, it);
+                return entries.front().model;
+            }
+        }
+        return nullptr;
+    };
+
+    {
+        const ScopedLock sl (lock);
+        if (auto model = find())
+            return model;
+    }
+
+    // builds take a while, other instances can use the cache meanwhile
+    std::shared_ptr<Model> newModel (factory());
+
+    {
+        const ScopedLock sl (lock);
+
+        // another instance built the same one first, use that so the weights are shared
+        if (auto model = find())
+            return model;
+
+        entries.push_front ({ key, newModel });
+        trim();
+    }
+    return newModel;
+}
+
+// drops the oldest models beyond the recent ones that nobody holds, the ones in use stay
+void ModelCache::trim()
+{
+    int idle = 0;
+    for (auto it = entries.begin(); it != entries.end();)
+    {
+        if (it->model.use_count() == 1 && ++idle > recentCapacity)
+            it = entries.erase (it);
+        else
+            ++it;
+    }
+}
@@ -0,0 +1,62 @@
+/*
+  ==============================================================================
+
+    ModelCache.h
+
+    Models shared by all the plugin instances in a process, held through a
+    SharedResourcePointer. Instances with the same settings run on one set of
+    weights (see Model::share), each with its own streaming state, and the
+    models of the most recently used settings are kept after the last instance
+    lets go of them, so going back to a setting doesn't need another build.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+#include "ronnlib.h"
+
+//==============================================================================
+class ModelCache
+{
+public:
+    // everything the shared weights depend on, the checksum is of the snapshot
+    // they were loaded from, 0 when they come from the seed
+    struct Key
+    {
+        WeightSnapshot::Hyperparameters model;
+        uint32 checksum = 0;
+        int eco = 0;
+        int precision = 0;
+
+        bool operator== (const Key& other) const;
+    };
+
+    // builds the model a key stands for, called without the lock held
+    typedef std::function<std::unique_ptr<Model>()> Factory;
+
+    ModelCache() = default;
+
+    // any thread but the audio thread: the model for key, from factory when it
+    // is neither in use nor among the recent ones. it must not be changed, use
+    // Model::share for a model to run
+    std::shared_ptr<Model> getModel (const Key& key, const Factory& factory);
+
+    // models nobody uses any more are kept for this many of the latest keys
+    int recentCapacity = 8;
+
+private:
+    struct Entry
+    {
+        Key key;
+        std::shared_ptr<Model> model;
+    };
+
+    void trim();
+
+    CriticalSection lock;
+    std::list<Entry> entries;   // most recently used first
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (ModelCache)
+};
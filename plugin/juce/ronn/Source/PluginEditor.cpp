@@ -45,6 +45,7 @@ RonnAudioProcessorEditor::RonnAudioProcessorEditor (RonnAudioProcessor& p, Audio
     useBiasButton.setButtonText ("Bias");
     linkGainButton.setButtonText ("Link");
     depthwiseButton.setButtonText ("Depthwise");
+    residualButton.setButtonText ("Residual");
 
     Colour fillColour = Colour (0xffececec); // side panel color
 
@@ -52,7 +53,7 @@ RonnAudioProcessorEditor::RonnAudioProcessorEditor (RonnAudioProcessor& p, Audio
     inputGainSlider.setSliderStyle (Slider::Rotary);
     inputGainSlider.setTextBoxStyle (Slider::TextBoxRight, false, 50, 24);//(Slider::NoTextBox, false, 0, 0);
     inputGainSlider.onValueChange = [this] {updateGains(true);};
-    inputGainSlider.setValue (juce::Decibels::gainToDecibels(processor.inputGainLn));
+    inputGainSlider.setValue (juce::Decibels::gainToDecibels(processor.inputGainLn.load()));
     inputGainSlider.setColour (Slider::textBoxBackgroundColourId, fillColour);
     inputGainSlider.setColour (Slider::textBoxOutlineColourId, fillColour);
     inputGainLabel.setText ("in", dontSendNotification);
@@ -62,7 +63,7 @@ RonnAudioProcessorEditor::RonnAudioProcessorEditor (RonnAudioProcessor& p, Audio
     outputGainSlider.setSliderStyle (Slider::Rotary);
     outputGainSlider.setTextBoxStyle (Slider::TextBoxRight, false, 50, 24);//(Slider::NoTextBox, false, 0, 0);
     outputGainSlider.onValueChange = [this] {updateGains(false);};
-    outputGainSlider.setValue (juce::Decibels::gainToDecibels(processor.outputGainLn));
+    outputGainSlider.setValue (juce::Decibels::gainToDecibels(processor.outputGainLn.load()));
     outputGainSlider.setColour (Slider::textBoxBackgroundColourId, fillColour);
     outputGainSlider.setColour (Slider::textBoxOutlineColourId, fillColour);
     outputGainLabel.setText ("out", dontSendNotification);
@@ -83,6 +84,7 @@ RonnAudioProcessorEditor::RonnAudioProcessorEditor (RonnAudioProcessor& p, Audio
     addAndMakeVisible (useBiasButton);
     addAndMakeVisible (linkGainButton);
     addAndMakeVisible (depthwiseButton);
+    addAndMakeVisible (residualButton);
     addAndMakeVisible (inputGainLabel);
     addAndMakeVisible (outputGainLabel);
 
@@ -182,6 +184,7 @@ RonnAudioProcessorEditor::RonnAudioProcessorEditor (RonnAudioProcessor& p, Audio
     useBiasAttachment.reset     (new ButtonAttachment   (valueTreeState, "useBias", useBiasButton));
     linkGainAttachment.reset    (new ButtonAttachment   (valueTreeState, "linkGain", linkGainButton));
     depthwiseAttachment.reset   (new ButtonAttachment   (valueTreeState, "depthwise", depthwiseButton));
+    residualAttachment.reset    (new ButtonAttachment   (valueTreeState, "residual", residualButton));
     //seedAttachment.reset        (new TextBoxAttachment  (valueTreeState, "seed", seedTextEditor));
 
     // callbacks for updating the model (not all parameters)
@@ -194,6 +197,9 @@ RonnAudioProcessorEditor::RonnAudioProcessorEditor (RonnAudioProcessor& p, Audio
     useBiasButton.onStateChange  = [this] { updateModelState(); };
     depthwiseButton.onStateChange = [this] { updateModelState(); };
 
+    // the model is rebuilt in the background, so poll for its parameter count
+    startTimerHz (10);
+
     setSize (600, 300);
 }
 
@@ -206,20 +212,20 @@ void RonnAudioProcessorEditor::updateGains(bool inputGain)
 {
   if (inputGain == true){
     processor.inputGainLn = juce::Decibels::decibelsToGain((float) inputGainSlider.getValue());
-    inputGainSlider.setValue (juce::Decibels::gainToDecibels(processor.inputGainLn));
+    inputGainSlider.setValue (juce::Decibels::gainToDecibels(processor.inputGainLn.load()));
     if (linkGainButton.getToggleState()) {
       float outputGaindB = -1 * inputGainSlider.getValue();
       processor.outputGainLn = juce::Decibels::decibelsToGain((float) outputGaindB);
-      outputGainSlider.setValue (juce::Decibels::gainToDecibels(processor.outputGainLn));
+      outputGainSlider.setValue (juce::Decibels::gainToDecibels(processor.outputGainLn.load()));
     }
   }
   else {
     processor.outputGainLn = juce::Decibels::decibelsToGain((float) outputGainSlider.getValue());
-    outputGainSlider.setValue (juce::Decibels::gainToDecibels(processor.outputGainLn));
+    outputGainSlider.setValue (juce::Decibels::gainToDecibels(processor.outputGainLn.load()));
     if (linkGainButton.getToggleState()) {
       float inputGaindB = -1 * outputGainSlider.getValue();
       processor.inputGainLn = juce::Decibels::decibelsToGain((float) inputGaindB);
-      inputGainSlider.setValue (juce::Decibels::gainToDecibels(processor.inputGainLn));
+      inputGainSlider.setValue (juce::Decibels::gainToDecibels(processor.inputGainLn.load()));
     }
   }
 }
@@ -227,12 +233,18 @@ void RonnAudioProcessorEditor::updateGains(bool inputGain)
 //==============================================================================
 void RonnAudioProcessorEditor::updateModelState()
 {
-  processor.modelChange = true;
+  // the processor listens to the parameters and rebuilds the model itself
   processor.calculateReceptiveField();
-  float rfms = (processor.receptiveFieldSamples / processor.sampleRate) * 1000;
+  float rfms = (processor.receptiveFieldSamples.load() / processor.sampleRate.load()) * 1000;
   receptiveFieldTextEditor.setText(String(rfms, 1));
-  int parameters = processor.model->getNumParameters();
-  parametersTextEditor.setText(String(parameters));
+  parametersTextEditor.setText(String(processor.getNumParameters()));
+}
+
+void RonnAudioProcessorEditor::timerCallback()
+{
+  auto parameters = String(processor.getNumParameters());
+  if (parametersTextEditor.getText() != parameters)
+    parametersTextEditor.setText(parameters);
 }
 
 //==============================================================================
@@ -318,6 +330,7 @@ void RonnAudioProcessorEditor::resized()
     auto toggleArea = area.removeFromTop (contentItemHeight);
     useBiasButton.setBounds       (toggleArea);
     linkGainButton.setBounds      (toggleArea.removeFromRight(60));
-    depthwiseButton.setBounds     (toggleArea.removeFromRight(120));
+    depthwiseButton.setBounds     (toggleArea.removeFromRight(100));
+    residualButton.setBounds      (toggleArea.removeFromRight(90));
 }
 
@@ -16,7 +16,8 @@
 //==============================================================================
 /**
 */
-class RonnAudioProcessorEditor  : public AudioProcessorEditor
+class RonnAudioProcessorEditor  : public AudioProcessorEditor,
+                                  private Timer
 {
 public:
     enum
@@ -41,6 +42,8 @@ public:
     void updateGains(bool inputGain);
 
 private:
+    void timerCallback() override;
+
     // This reference is provided as a quick way for your editor to
     // access the processor object that created it.
     RonnAudioProcessor& processor;
@@ -53,8 +56,8 @@ private:
     Label layersLabel, kernelLabel, channelsLabel;
     std::unique_ptr<SliderAttachment> layersAttachment, kernelAttachment, channelsAttachment;
  
-    ToggleButton useBiasButton, linkGainButton, depthwiseButton; 
-    std::unique_ptr<ButtonAttachment> useBiasAttachment, linkGainAttachment, depthwiseAttachment;
+    ToggleButton useBiasButton, linkGainButton, depthwiseButton, residualButton; 
+    std::unique_ptr<ButtonAttachment> useBiasAttachment, linkGainAttachment, depthwiseAttachment, residualAttachment;
 
     ComboBox dilationsComboBox, activationsComboBox, initTypeComboBox;
     Label dilationsLabel, activationsLabel, initTypeLabel;
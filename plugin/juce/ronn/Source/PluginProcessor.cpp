@@ -12,6 +12,18 @@
 #include "PluginEditor.h"
 #include "ronnlib.h"
 
+// parameters that change the network itself and need a new model
+static const char* modelParameterIDs[] = { "layers", "kernel", "channels", "useBias", "activation",
+                                           "dilation", "initType", "seed", "depthwise", "residual", "multicore", "dualMono",
+                                           "internalBlock", "oversampling", "morphSeed", "precision", "eco" };
+
+// choices of the internal block size, the host block size or a fixed block that is
+// collected from smaller host blocks at the cost of one block of latency
+static const int internalBlockSizes[] = { 0, 128, 256, 512, 1024, 2048 };
+
+// input and output below this (-120 dBFS) count as silence for the idle bypass
+static const float silenceLevel = 1.0e-6f;
+
 //==============================================================================
 RonnAudioProcessor::RonnAudioProcessor()
 #ifndef JucePlugin_PreferredChannelConfigurations
@@ -37,7 +49,21 @@ RonnAudioProcessor::RonnAudioProcessor()
         std::make_unique<AudioParameterInt>   ("initType", "Init Type", 1, 6, 1),
         std::make_unique<AudioParameterInt>   ("seed", "Seed", 0, 1024, 42),
         std::make_unique<AudioParameterBool>  ("linkGain", "Link", false),
-        std::make_unique<AudioParameterBool>  ("depthwise", "Depthwise", false)
+        std::make_unique<AudioParameterBool>  ("depthwise", "Depthwise", false),
+        std::make_unique<AudioParameterBool>  ("residual", "Residual", false),
+        std::make_unique<AudioParameterBool>  ("multicore", "Multicore", false),
+        std::make_unique<AudioParameterBool>  ("dualMono", "Per Channel", false),
+        std::make_unique<AudioParameterChoice>("internalBlock", "Internal Block",
+                                               StringArray { "Host", "128", "256", "512", "1024", "2048" }, 0),
+        std::make_unique<AudioParameterChoice>("oversampling", "Oversampling",
+                                               StringArray { "Off", "2x", "4x", "8x" }, 0),
+        std::make_unique<AudioParameterFloat> ("cond1", "Condition 1", -1.0f, 1.0f, 0.0f),
+        std::make_unique<AudioParameterFloat> ("cond2", "Condition 2", -1.0f, 1.0f, 0.0f),
+        std::make_unique<AudioParameterInt>   ("morphSeed", "Morph Seed", 0, 1024, 43),
+        std::make_unique<AudioParameterFloat> ("morph", "Morph", 0.0f, 1.0f, 0.0f),
+        std::make_unique<AudioParameterChoice>("morphMode", "Morph Mode", StringArray { "Linear", "Spherical" }, 1),
+        std::make_unique<AudioParameterChoice>("precision", "Precision", StringArray { "Float32", "Int8" }, 0),
+        std::make_unique<AudioParameterChoice>("eco", "Eco", StringArray { "Off", "Light", "Strong" }, 0)
     })
 {
  
@@ -52,24 +78,33 @@ RonnAudioProcessor::RonnAudioProcessor()
     initTypeParameter   = parameters.getRawParameterValue ("initType");
     seedParameter       = parameters.getRawParameterValue ("seed");
     depthwiseParameter  = parameters.getRawParameterValue ("depthwise");
+    residualParameter   = parameters.getRawParameterValue ("residual");
+    multicoreParameter  = parameters.getRawParameterValue ("multicore");
+    dualMonoParameter   = parameters.getRawParameterValue ("dualMono");
+    internalBlockParameter = parameters.getRawParameterValue ("internalBlock");
+    oversamplingParameter  = parameters.getRawParameterValue ("oversampling");
+    conditionParameters[0] = parameters.getRawParameterValue ("cond1");
+    conditionParameters[1] = parameters.getRawParameterValue ("cond2");
+    morphSeedParameter  = parameters.getRawParameterValue ("morphSeed");
+    morphParameter      = parameters.getRawParameterValue ("morph");
+    morphModeParameter  = parameters.getRawParameterValue ("morphMode");
+    precisionParameter  = parameters.getRawParameterValue ("precision");
+    ecoParameter        = parameters.getRawParameterValue ("eco");
 
     // neural network model
-    model = std::make_shared<Model>(nInputs, 
-                                   nOutputs, 
-                                   *layersParameter, 
-                                   *channelsParameter, 
-                                   *kernelParameter, 
-                                   *dilationParameter,
-                                   *useBiasParameter, 
-                                   *activationParameter,
-                                   *initTypeParameter,
-                                   *seedParameter,
-                                   *depthwiseParameter);
+    model = createModel();
+
+    // architecture changes are rebuilt in the background, and so is the start or end of a morph
+    for (auto id : modelParameterIDs)
+        parameters.addParameterListener (id, this);
+    parameters.addParameterListener ("morph", this);
 }
 
 RonnAudioProcessor::~RonnAudioProcessor()
 {
-    // we may need to delete the model here
+    for (auto id : modelParameterIDs)
+        parameters.removeParameterListener (id, this);
+    parameters.removeParameterListener ("morph", this);
 }
 
 //==============================================================================
@@ -107,7 +142,9 @@ bool RonnAudioProcessor::isMidiEffect() const
 
 double RonnAudioProcessor::getTailLengthSeconds() const
 {
-    return 0.0;
+    // the output follows the input for a receptive field, plus the latency of the model
+    double rate = sampleRate.load();
+    return rate > 0.0 ? (receptiveFieldSamples.load() + modelLatencySamples.load()) / rate : 0.0;
 }
 
 int RonnAudioProcessor::getNumPrograms()
@@ -141,9 +178,10 @@ void RonnAudioProcessor::prepareToPlay (double sampleRate_, int samplesPerBlock_
     sampleRate = sampleRate_;
     blockSamples = samplesPerBlock_;
 
-    // setup high pass filter model
+    // setup high pass filter model, prepareToPlay may be called again with a new layout
     double freq = 10.0;
     double q = 10.0;
+    highPassFilters.clear();
     for (int channel = 0; channel < getTotalNumOutputChannels(); ++channel) {
         IIRFilter filter;
         filter.setCoefficients(IIRCoefficients::makeHighPass (sampleRate_, freq, q));
@@ -167,10 +205,10 @@ bool RonnAudioProcessor::isBusesLayoutSupported (const BusesLayout& layouts) con
     ignoreUnused (layouts);
     return true;
   #else
-    // This is the place where you check if the layout is supported.
-    // In this template code we only support mono or stereo.
-    if (layouts.getMainOutputChannelSet() != AudioChannelSet::mono()
-     && layouts.getMainOutputChannelSet() != AudioChannelSet::stereo())
+    // anything from mono up to 7.1, one network input and output per channel, or
+    // a lane of a mono network per channel
+    auto channels = layouts.getMainOutputChannelSet().size();
+    if (channels < 1 || channels > 8)
         return false;
 
     // This checks if the input layout matches the output layout
@@ -184,118 +222,209 @@ bool RonnAudioProcessor::isBusesLayoutSupported (const BusesLayout& layouts) con
 }
 #endif
 
+int RonnAudioProcessor::getOversamplingFactor() const
+{
+    return 1 << jlimit(0, 3, (int) *oversamplingParameter);
+}
+
+// receptive field of a model in frames of the host rate
+static int getHostReceptiveField (Model& m)
+{
+    return (m.getReceptiveField() + m.getOversampling() - 1) / m.getOversampling();
+}
+
 void RonnAudioProcessor::calculateReceptiveField()
 {
     int k = *kernelParameter;
     int d = *dilationParameter;
     int l = *layersParameter;
-    double rf =  k * d;
+    double rf = 1;
 
-    for (int layer = 1; layer < l; ++layer) {
+    for (int layer = 0; layer < l; ++layer) {
         rf = rf + ((k-1) * pow(d,layer));
     }
 
-    receptiveFieldSamples = rf; // store in attribute
+    // the network runs oversampled, so it reaches back less far at the host rate
+    receptiveFieldSamples = (int) std::ceil(rf / getOversamplingFactor()); // store in attribute
 }
 
 void RonnAudioProcessor::setupBuffers()
 {
-    // compute the size of the buffer which will be passed to model
-    mBufferLength = (int)(receptiveFieldSamples + blockSamples - 1);
-    iBufferLength = (int)(receptiveFieldSamples + blockSamples - 1);
-
-    // Initialize the to n channels
+    // Initialize the to n channels, the network has at least a stereo output
     nInputs = getTotalNumInputChannels();
+    nOutputs = jmax (2, getTotalNumOutputChannels());
+
+    // we are not playing yet, so the model for this channel layout, block size
+    // and sample rate (which decide the pipeline stages) can be built right here
+    fadingModel.reset();
+    model = createModel();
+    silentSamples = 0;
+    outputSilent = false;
+    receptiveFieldSamples = getHostReceptiveField(*model);
+    modelLatencySamples = model->getLatencySamples();
+    setLatencySamples(modelLatencySamples);
+
+    // everything processBlock touches is allocated here, per channel models have a lane per input
+    fadeBuffer.setSize(nOutputs, jmax(1, blockSamples.load()));
+    outputPointers.resize(jmax(1, nInputs.load()) * nOutputs);
+    fadingPointers.resize(jmax(1, nInputs.load()) * nOutputs);
+}
 
-    // and mBufferLength samples per channel
-    mBuffer.setSize(nInputs, mBufferLength);
-    mBuffer.clear();
-    mBufferReadIdx = 0;
-    mBufferWriteIdx = 0;
+void RonnAudioProcessor::handleAsyncUpdate()
+{
+    setLatencySamples(modelLatencySamples.load());
+}
+
+void RonnAudioProcessor::parameterChanged (const String& parameterID, float newValue)
+{
+    // may be called from the audio thread, the request itself is lock-free. the morph amount
+    // is applied by the models, only moving away from zero or back needs a new one
+    if (parameterID == "morph")
+    {
+        bool enable = newValue > 0.0f;
+        if (morphEnabled.exchange (enable) == enable)
+            return;
+    }
+    modelBuilder.requestBuild();
+}
 
-    // this buffer stories copy of data in mBuffer (always read from index 0)
-    iBuffer.setSize(nInputs, iBufferLength);
-    iBuffer.clear();
+// where a host input channel goes in a model, per channel models take one channel per lane
+static float* getModelInput (Model& m, int channel)
+{
+    return m.getLanes() > 1 ? m.getInputPointer(0, channel) : m.getInputPointer(channel);
+}
+
+// the rows a model writes each output of each lane to, the outputs of a whole bus model
+// or the single output of each lane of a per channel model go to the channels in order
+static void getModelOutputs (Model& m, std::vector<float*>& pointers, AudioBuffer<float>& buffer, int start, int numChannels)
+{
+    for (int row = 0; row < m.getLanes() * m.getOutputs(); ++row)
+        pointers[row] = row < numChannels ? buffer.getWritePointer(row, start) : nullptr;
 }
 
 void RonnAudioProcessor::processBlock (AudioBuffer<float>& buffer, MidiBuffer& midiMessages)
 {
     ScopedNoDenormals noDenormals;
-    auto inChannels  = getTotalNumInputChannels();
-    auto outChannels = getTotalNumOutputChannels();
-
-    if (modelChange == true) {
-        buildModel(*seedParameter);
-        calculateReceptiveField();
-        setupBuffers();
-        modelChange = false;
+    auto outChannels = jmin(getTotalNumOutputChannels(), (int) highPassFilters.size());
+    auto numSamples  = buffer.getNumSamples();
+
+    // hosts may send any length, longer blocks than promised are run in pieces
+    // below, so nothing here depends on the size given to prepareToPlay
+
+    // pick up a model rebuilt on the background thread and fade over to it
+    if (fadingModel == nullptr) {
+        if (auto* newModel = modelBuilder.takeModel()) {
+            if (newModel->getInputs() * newModel->getLanes() == nInputs) {
+                fadingModel = std::move(model);
+                model.reset(newModel);
+                crossfadePosition = 0;
+                receptiveFieldSamples = getHostReceptiveField(*model);
+                silentSamples = 0;      // a new model starts from an empty history, not from silence
+
+                // the host is told about a new pipeline latency from the message thread
+                if (model->getLatencySamples() != modelLatencySamples.load()) {
+                    modelLatencySamples = model->getLatencySamples();
+                    triggerAsyncUpdate();
+                }
+            }
+            else
+                modelBuilder.retireModel(newModel);     // built for a previous channel layout
+        }
     }
 
     //if (true) {
     //    model->initModel(std::rand() %  1024);
     //}
 
-    int twp, trp; // temporary write/read pointer counters
-
-    for (int channel = 0; channel < nInputs; ++channel) {
+    // FiLM conditioning, the models only evaluate it again when the values have changed
+    float condition[] = { conditionParameters[0]->load(), conditionParameters[1]->load() };
+    model->setCondition(condition);
+    if (fadingModel != nullptr)
+        fadingModel->setCondition(condition);
+
+    // the gains are folded into the weights, which are only rewritten when they change
+    float inputGain = inputGainLn.load(), outputGain = outputGainLn.load();
+    model->setGains(inputGain, outputGain);
+    if (fadingModel != nullptr)
+        fadingModel->setGains(inputGain, outputGain);
+
+    // the models morph towards the morph seed's weights a slice per block
+    float morph = morphParameter->load();
+    bool spherical = morphModeParameter->load() > 0.5f;
+    model->setMorph(morph, spherical);
+    if (fadingModel != nullptr)
+        fadingModel->setMorph(morph, spherical);
+
+    // after silence for longer than the model and its filters reach back, its state is what
+    // silence settles on, so skipping further silent blocks only shifts that in time and the
+    // model picks up where it stopped when signal returns. the high pass stops with it once
+    // its output has died away. anything that changes the weights needs a new settled state
+    float controls[] = { condition[0], condition[1], inputGain, outputGain, morph, spherical ? 1.0f : 0.0f };
+    if (! std::equal (std::begin (controls), std::end (controls), std::begin (idleControls)) || model->isMorphing())
+    {
+        std::copy (std::begin (controls), std::end (controls), std::begin (idleControls));
+        silentSamples = 0;
+    }
 
-        // to process each channel reset the pointers to global state
-        twp = mBufferWriteIdx; 
-        trp = mBufferReadIdx;  
+    bool inputSilent = true;
+    for (int channel = 0; channel < nInputs; ++channel)
+        inputSilent = inputSilent && buffer.getMagnitude (channel, 0, numSamples) < silenceLevel;
+    silentSamples = inputSilent ? jmin (silentSamples + numSamples, std::numeric_limits<int>::max() / 2) : 0;
+
+    // a linear phase filter reaches back twice its latency
+    int settleSamples = receptiveFieldSamples.load() + 2 * modelLatencySamples.load();
+    if (fadingModel == nullptr && outputSilent && silentSamples > settleSamples) {
+        for (int channel = 0; channel < getTotalNumOutputChannels(); ++channel)
+            buffer.clear (channel, 0, numSamples);
+        return;
+    }
 
-        // first we copy the input to circular buffer
-        for (int n = 0; n < blockSamples; n++) {
-            mBuffer.setSample(channel, twp, buffer.getSample(channel, n));
-            twp = twp + 1;
-            if (twp > (mBufferLength-1)){
-                twp = 0;
-            }
+    // run the host block through in pieces the models can take, a fixed block
+    // model only takes what is left of the block it is collecting
+    for (int start = 0, n = 0; start < numSamples; start += n) {
+        n = jmin(numSamples - start, model->getMaxFrames());
+        if (fadingModel != nullptr)
+            n = jmin(n, fadingModel->getMaxFrames(), fadeBuffer.getNumSamples());
+
+        // de-interleave the host block into the network input
+        for (int channel = 0; channel < nInputs; ++channel) {
+            auto* input = getModelInput(*model, channel);
+            FloatVectorOperations::copy(input, buffer.getReadPointer(channel, start), n);
+            if (fadingModel != nullptr)
+                FloatVectorOperations::copy(getModelInput(*fadingModel, channel), input, n);
         }
 
-        trp = twp;  // start reading from where we finished writing
-
-        // now we read these data into new time-aligned buffer
-        for (int n = 0; n < mBufferLength; n++) {
-            iBuffer.setSample(channel, n, mBuffer.getSample(channel, trp));
-            trp = trp + 1; 
-            if (trp > (mBufferLength-1)){
-                trp = 0;
+        // the network writes its output straight into the host buffer
+        getModelOutputs(*model, outputPointers, buffer, start, outChannels);
+        model->process(n, outputPointers.data());
+
+        // the old model keeps running until it is faded out
+        if (fadingModel != nullptr) {
+            getModelOutputs(*fadingModel, fadingPointers, fadeBuffer, 0, outChannels);
+            fadingModel->process(n, fadingPointers.data());
+
+            for (int channel = 0; channel < outChannels; ++channel) {
+                auto* out = buffer.getWritePointer(channel, start);
+                auto* fading = fadeBuffer.getReadPointer(channel);
+                for (int i = 0; i < n; i++) {
+                    float g = jmin(1.0f, (float) (crossfadePosition + start + i) / (float) crossfadeSamples);
+                    out[i] = fading[i] + g * (out[i] - fading[i]);
+                }
             }
         }
     }
 
-    // now update the read and writer pointer/indices for global state
-    mBufferWriteIdx = twp;
-    mBufferReadIdx  = trp;
-
-    std::vector<int64_t> sizes = {iBufferLength};                       // size of the buffer data
-    auto* iBufferData = iBuffer.getWritePointer(0);                     // get pointer of the first channel 
-    at::Tensor tensorFrame = torch::from_blob(iBufferData, sizes);      // load data from buffer into tensor type
-    tensorFrame = torch::mul(tensorFrame, inputGainLn);  // apply the input gain first
-
-    if (nInputs > 1){
-        auto* iBufferData = iBuffer.getWritePointer(1);                         // get pointer of the second channel 
-        at::Tensor tensorFrameR = torch::from_blob(iBufferData, sizes);         // load data from buffer into tensor type
-        tensorFrameR = torch::mul(tensorFrameR, inputGainLn);    // apply the input gain first
-        tensorFrame = at::stack({tensorFrame, tensorFrameR});    // stack the two channels to form the stereo tensor
-        //std::cout << "input" << tensorFrame.sizes() << std::endl;
-    }
-
-    tensorFrame = torch::reshape(tensorFrame, {1,nInputs,iBufferLength});
-    //std::cout << "input reshape" << tensorFrame.sizes() << std::endl;
-
-    auto outputFrame = model->forward(tensorFrame);                             // process audio through network
-    //std::cout << "output" << outputFrame.sizes() << std::endl;
-
-    // now load the output channels back into the buffer
+    outputSilent = true;
     for (int channel = 0; channel < outChannels; ++channel) {
-        auto outputData = outputFrame.index({0,channel,torch::indexing::Slice()});      // index the proper output channel
-        auto outputDataPtr = outputData.data_ptr<float>();                              // get pointer to the output data
-        buffer.copyFrom(channel,0,outputDataPtr,blockSamples);                          // copy output data to buffer
-        highPassFilters[channel].processSamples (buffer.getWritePointer (channel), buffer.getNumSamples());
+        highPassFilters[channel].processSamples (buffer.getWritePointer (channel), numSamples);
+        outputSilent = outputSilent && buffer.getMagnitude (channel, 0, numSamples) < silenceLevel;
     }
-    buffer.applyGain(outputGainLn);                                  // apply the output gain
 
+    if (fadingModel != nullptr) {
+        crossfadePosition += numSamples;
+        if (crossfadePosition >= crossfadeSamples)
+            modelBuilder.retireModel(fadingModel.release());            // destroyed on the builder thread
+    }
 }
 
 //==============================================================================
@@ -315,6 +444,15 @@ void RonnAudioProcessor::getStateInformation (MemoryBlock& destData)
     auto state = parameters.copyState();
     std::unique_ptr<XmlElement> xml (state.createXml());
     copyXmlToBinary (*xml, destData);
+
+    // the exact weights follow the parameters on an aligned offset, older versions only read the xml
+    const ScopedLock sl (weightsLock);
+    if (! modelWeights.empty())
+    {
+        auto offset = getWeightsOffset (destData.getSize());
+        destData.setSize (offset + modelWeights.size(), true);
+        destData.copyFrom (modelWeights.data(), (int) offset, modelWeights.size());
+    }
 }
 
 void RonnAudioProcessor::setStateInformation (const void* data, int sizeInBytes)
@@ -324,23 +462,166 @@ void RonnAudioProcessor::setStateInformation (const void* data, int sizeInBytes)
     if (xmlState.get() != nullptr)
         if (xmlState->hasTagName (parameters.state.getType()))
             parameters.replaceState (ValueTree::fromXml (*xmlState));
+
+    // models are built from the saved weights for as long as the parameters match them
+    std::shared_ptr<WeightSnapshot> weights;
+    if (xmlState.get() != nullptr)
+    {
+        // copyXmlToBinary writes a magic number, the length and the null terminated xml
+        auto xmlSize = (size_t) ByteOrder::littleEndianInt (addBytesToPointer (data, 4)) + 9;
+        auto offset = getWeightsOffset (xmlSize);
+        if (offset < (size_t) sizeInBytes)
+            weights = std::make_shared<WeightSnapshot> (addBytesToPointer (data, offset), (size_t) sizeInBytes - offset);
+        if (weights != nullptr && ! weights->isValid())
+            weights.reset();
+    }
+
+    {
+        const ScopedLock sl (weightsLock);
+        stateWeights = weights;
+    }
+    modelBuilder.requestBuild();
+}
+
+size_t RonnAudioProcessor::getWeightsOffset (size_t xmlSize)
+{
+    return (xmlSize + WeightSnapshot::alignment - 1) / WeightSnapshot::alignment * WeightSnapshot::alignment;
 }
 
 //==============================================================================
 
-void RonnAudioProcessor::buildModel(int seed) 
-{
-    model.reset(new Model(nInputs, 
-                        nOutputs, 
-                        *layersParameter, 
-                        *channelsParameter, 
-                        *kernelParameter, 
-                        *dilationParameter,
-                        *useBiasParameter,
-                        *activationParameter,
-                        *initTypeParameter,
-                        *seedParameter,
-                        *depthwiseParameter));
+// everything but the weights the same, so a model can be reinitialised into the other
+static bool isSameShape (WeightSnapshot::Hyperparameters a, WeightSnapshot::Hyperparameters b)
+{
+    a.seed = b.seed;
+    a.initType = b.initType;
+    return a == b;
+}
+
+// the shared model for a cache key, pruned and quantised as the key says
+static std::unique_ptr<Model> buildSharedModel (const ModelCache::Key& key, const WeightSnapshot* weights)
+{
+    const auto& h = key.model;
+    std::unique_ptr<Model> newModel (new Model(h.inputs, h.outputs, h.layers, h.channels, h.kernelWidth,
+                                               h.dilationFactor, h.bias != 0, h.activation, h.initType,
+                                               h.seed, h.depthwise != 0, h.residual != 0, weights));
+
+    // cheaper hidden layers for big presets, saveWeights keeps the full float weights.
+    // eco prunes all but the largest half or quarter of the hidden layer weights
+    if (key.eco > 0)
+        newModel->prune (0.0f, key.eco == 1 ? 0.5f : 0.25f);
+    newModel->setPrecision ((Conv1dKernel::Precision) key.precision);
+    return newModel;
+}
+
+std::unique_ptr<Model> RonnAudioProcessor::createModel (std::unique_ptr<Model> spare)
+{
+    // the channel layout and gains can change while this runs, the model is built for one of them
+    int inputs = nInputs.load(), outputs = nOutputs.load();
+
+    // per channel, each input channel runs through its own lane of a mono in, mono out network,
+    // so every channel of any bus sees the same weights and one model serves them all
+    bool perChannel = *dualMonoParameter > 0.5f;
+
+    std::shared_ptr<WeightSnapshot> weights;
+    {
+        const ScopedLock sl (weightsLock);
+        weights = stateWeights;
+    }
+
+    ModelCache::Key key;
+    key.model = { perChannel ? 1 : inputs, perChannel ? 1 : outputs, (int) *layersParameter, (int) *channelsParameter,
+                  (int) *kernelParameter, (int) *dilationParameter, (int) *activationParameter,
+                  (int) *initTypeParameter, (int) *seedParameter, *useBiasParameter != 0.0f,
+                  *depthwiseParameter != 0.0f, *residualParameter != 0.0f };
+
+    // weights from the state only go with the model they were saved from
+    const WeightSnapshot* stateSnapshot = nullptr;
+    if (weights != nullptr && weights->isValid() && weights->getHeader().model == key.model)
+    {
+        stateSnapshot = weights.get();
+        key.checksum = weights->getHeader().checksum;
+    }
+
+    // a morphing model rewrites all of its weights, so it is pruned and quantised itself
+    // after the morph, and the cached models it morphs between stay at full precision
+    bool morph = *morphParameter > 0.0f && (int) *morphSeedParameter != (int) *seedParameter;
+    int eco = jlimit (0, 2, (int) *ecoParameter);
+    int precision = *precisionParameter > 0.5f ? Conv1dKernel::Int8 : Conv1dKernel::Float32;
+    if (! morph)
+    {
+        key.eco = eco;
+        key.precision = precision;
+    }
+
+    int internalBlock = internalBlockSizes[jlimit(0, (int) numElementsInArray(internalBlockSizes) - 1,
+                                                  (int) *internalBlockParameter)];
+    int maxBlockSize = internalBlock > 0 ? internalBlock : blockSamples.load();
+
+    // when only the seed or the init type changed, the model the audio thread gave back
+    // last gets new weights in place, keeping its buffers. anything else is built anew,
+    // instances with the same settings run on the same weights, only the packed copies
+    // and the streaming state below are this instance's own
+    std::unique_ptr<Model> newModel;
+    bool reused = spare != nullptr && stateSnapshot == nullptr
+               && isSameShape (spare->getHyperparameters(), key.model)
+               && spare->getLanes() == (perChannel ? inputs : 1)
+               && spare->isFixedBlock() == (internalBlock > 0)
+               && spare->getOversampling() == getOversamplingFactor()
+               && spare->getMaxBlockSize() == jmax (1, maxBlockSize) * getOversamplingFactor();
+    if (reused)
+    {
+        spare->reinitialise (key.model.seed, (Model::InitType) key.model.initType);
+        newModel = std::move (spare);
+    }
+    else
+    {
+        newModel = Model::share (modelCache->getModel (key, [&] { return buildSharedModel (key, stateSnapshot); }));
+    }
+
+    // a second initialisation from the morph seed to morph towards
+    if (morph)
+    {
+        ModelCache::Key targetKey = key;
+        targetKey.model.seed = (int) *morphSeedParameter;
+        targetKey.checksum = 0;
+        auto target = modelCache->getModel (targetKey, [&] { return buildSharedModel (targetKey, nullptr); });
+        newModel->setMorphTarget (*target);
+        newModel->setMorph (*morphParameter, *morphModeParameter > 0.5f);
+        newModel->finishMorph();
+    }
+
+    // keep the exact weights for getStateInformation
+    std::vector<char> snapshot;
+    newModel->saveWeights (snapshot);
+    {
+        const ScopedLock sl (weightsLock);
+        modelWeights.swap (snapshot);
+    }
+
+    if (morph || reused)
+    {
+        if (eco > 0)
+            newModel->prune (0.0f, eco == 1 ? 0.5f : 0.25f);
+        newModel->setPrecision ((Conv1dKernel::Precision) precision);
+    }
+
+    // allocate the streaming state here so the audio thread doesn't have to
+    if (! reused)
+        newModel->prepareStreaming(maxBlockSize, perChannel ? inputs : 1, internalBlock > 0, getOversamplingFactor());
+
+    // a linear network collapses into a single convolution, with the current
+    // conditioning and gains so the first blocks don't undo the merge
+    float condition[] = { conditionParameters[0]->load(), conditionParameters[1]->load() };
+    newModel->setCondition (condition);
+    newModel->setGains (inputGainLn.load(), outputGainLn.load());
+    newModel->optimise();
+
+    // spread big networks over the other cores when they can't keep up on the audio thread
+    if (*multicoreParameter > 0.5f)
+        newModel->preparePipeline(sampleRate, jmax(1, SystemStats::getNumCpus() - 1));
+    numParameters = newModel->getNumParameters();
+    return newModel;
 }
 
 //==============================================================================
@@ -12,11 +12,15 @@
 
 #include <JuceHeader.h>
 #include "ronnlib.h"
+#include "ModelBuilder.h"
+#include "ModelCache.h"
 
 //==============================================================================
 /**
 */
-class RonnAudioProcessor  : public AudioProcessor
+class RonnAudioProcessor  : public AudioProcessor,
+                            private AudioProcessorValueTreeState::Listener,
+                            private AsyncUpdater
 {
 public:
     //==============================================================================
@@ -59,38 +63,48 @@ public:
     //==============================================================================
     void calculateReceptiveField();
     void setupBuffers();
+    int getOversamplingFactor() const;     // 1, 2, 4 or 8
 
     //==============================================================================
     AudioParameterInt* layers;
 
     //==============================================================================
-    void buildModel(int seed);
-    bool modelChange = true;
+    std::unique_ptr<Model> createModel (std::unique_ptr<Model> spare = nullptr);
+    int getNumParameters() const { return numParameters.load(); }
 
-    // define the model config
-    int nInputs     = 1;
-    int nOutputs    = 2;
+    // define the model config, the channel counts are read by the builder thread
+    std::atomic<int> nInputs  { 1 };
+    std::atomic<int> nOutputs { 2 };     // follows the output bus, at least 2
     int nChannels   = 8;
     int kWidth      = 3;
     int dFactor     = 1;
     bool useBias    = false;
     Model::Activation act = Model::Activation::ReLU;
     Model::InitType initType = Model::InitType::normal;
-    std::shared_ptr<Model> model;
+    std::unique_ptr<Model> model;         // only touched by the audio thread once playing
+    std::unique_ptr<Model> fadingModel;   // previous model while crossfading to a rebuilt one
+
+    int crossfadeSamples = 2048;          // length of the fade when a rebuilt model is swapped in
+    int crossfadePosition = 0;
 
     int seed = 42;
-    int receptiveFieldSamples = 0; // in samples
-    int blockSamples = 0; // in/out samples
-    double sampleRate = 0; // in Hz
+    std::atomic<int> receptiveFieldSamples { 0 };    // in samples, read by the editor and the host
+    std::atomic<int> blockSamples { 0 };     // largest host block, read by the builder thread
+    std::atomic<double> sampleRate { 0 };    // in Hz, read by the builder thread
 
-    // holder for the linear gain values
+    // holder for the linear gain values, set by the editor
     // (don't want to convert dB -> linear on audio thread)
-    float inputGainLn, outputGainLn;
+    std::atomic<float> inputGainLn { 1.0f }, outputGainLn { 1.0f };
 
 private:
     //==============================================================================
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (RonnAudioProcessor)
 
+    //==============================================================================
+    void parameterChanged (const String& parameterID, float newValue) override;
+    void handleAsyncUpdate() override;
+    static size_t getWeightsOffset (size_t xmlSize);
+
     //==============================================================================
     AudioProcessorValueTreeState parameters;
 
@@ -106,13 +120,46 @@ private:
     std::atomic<float>* initTypeParameter   = nullptr;
     std::atomic<float>* seedParameter       = nullptr;
     std::atomic<float>* depthwiseParameter  = nullptr;
+    std::atomic<float>* residualParameter   = nullptr;
+    std::atomic<float>* multicoreParameter  = nullptr;
+    std::atomic<float>* dualMonoParameter   = nullptr;
+    std::atomic<float>* internalBlockParameter = nullptr;
+    std::atomic<float>* oversamplingParameter  = nullptr;
+    std::atomic<float>* conditionParameters[2] = { nullptr, nullptr };   // FiLM conditioning vector
+    std::atomic<float>* morphSeedParameter  = nullptr;
+    std::atomic<float>* morphParameter      = nullptr;
+    std::atomic<float>* morphModeParameter  = nullptr;
+    std::atomic<float>* precisionParameter  = nullptr;
+    std::atomic<float>* ecoParameter        = nullptr;
 
 
-    AudioSampleBuffer mBuffer; // circular buffer to store input data
-    AudioSampleBuffer iBuffer; // non-circular buffer that reads data from mBuffer to pass to model
-    int mBufferLength, iBufferLength, nBufferChannels;
-    int mBufferReadIdx, mBufferWriteIdx;
-
     std::vector<IIRFilter> highPassFilters; // high pass filters for the left and right channels
 
+    AudioBuffer<float> fadeBuffer;          // output of the fading model during a crossfade
+    std::vector<float*> outputPointers;     // where the models write each output channel
+    std::vector<float*> fadingPointers;
+
+    // idle bypass, the silent input so far in samples, whether the last output was
+    // silent and the values of the controls that change the weights
+    int silentSamples = 0;
+    bool outputSilent = false;
+    float idleControls[6] = {};
+
+    // whether the morph amount is above zero, the models are only built to morph then,
+    // at zero they run on the seed's weights alone like any other instance
+    std::atomic<bool> morphEnabled { false };
+
+    std::atomic<int> numParameters { 0 };   // of the most recently built model, read by the editor
+    std::atomic<int> modelLatencySamples { 0 };  // of the current model, reported to the host by handleAsyncUpdate
+
+    // weight snapshots, shared with the builder thread
+    CriticalSection weightsLock;
+    std::shared_ptr<WeightSnapshot> stateWeights;  // from setStateInformation
+    std::vector<char> modelWeights;                // of the most recently built model, saved with the state
+
+    // weights shared with the other instances in the process
+    SharedResourcePointer<ModelCache> modelCache;
+
+    // declared last so the builder thread stops before anything it uses is destroyed
+    ModelBuilder modelBuilder { [this] (std::unique_ptr<Model> spare) { return createModel (std::move (spare)); } };
 };
@@ -0,0 +1,235 @@
+#ifndef ACTIVATIONS_H
+#define ACTIVATIONS_H
+
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+
+// Fast approximations of the activation functions, written once over the
+// compiler's generic vector types so the same code runs 4, 8 or 16 frames
+// at a time and can be inlined into the AVX2/AVX-512 conv tiles, where the
+// activation is applied to the accumulators before they are stored.
+//
+// Maximum error against double precision references, measured by convbench
+// over [-20, 20] ([-100, 100] for Sine30) relative to max(1, |f(x)|):
+//
+//   Linear, ReLU, LeakyReLU, RReLU, Softshrink    exact up to float rounding
+//   Tanh, Sigmoid                                 2e-7   1 - 2 / (exp(2x) + 1), 1 / (1 + exp(-x))
+//   ELU, SELU                                     2e-7   exp(x) - 1
+//   GELU                                          3e-7   A&S 7.1.26 erf, 1.5e-7 absolute
+//   Softplus                                      2e-7   max(x, 0) + log(1 + exp(-|x|))
+//   Sine, Sine30                                  3e-7   2 pi reduction, degree 11 on [0, pi/2]
+//
+// All of these are far below the 24 bit resolution of the audio itself.
+// They rely on IEEE rounding for (x + 1.5 * 2^23) - 1.5 * 2^23, so this
+// file must not be built with -ffast-math.
+
+namespace activations {
+
+    // same order as Model::Activation
+    enum Type {Linear, LeakyReLU, Tanh, Sigmoid, ReLU, ELU, SELU, GELU, RReLU, Softplus, Softshrink, Sine, Sine30};
+
+#if defined(__GNUC__) || defined(__clang__)
+
+ #if defined(__GNUC__) && !defined(__clang__)
+  #pragma GCC diagnostic push
+  #pragma GCC diagnostic ignored "-Wpsabi"     // 32/64 byte vectors are only passed around once inlined
+ #endif
+
+    typedef float   vf1  __attribute__((vector_size(4)));
+    typedef int32_t vi1  __attribute__((vector_size(4)));
+    typedef float   vf4  __attribute__((vector_size(16)));
+    typedef int32_t vi4  __attribute__((vector_size(16)));
+    typedef float   vf8  __attribute__((vector_size(32)));
+    typedef int32_t vi8  __attribute__((vector_size(32)));
+    typedef float   vf16 __attribute__((vector_size(64)));
+    typedef int32_t vi16 __attribute__((vector_size(64)));
+
+    template <class VF> struct Mask;
+    template <> struct Mask<vf1>  { typedef vi1  Type; };
+    template <> struct Mask<vf4>  { typedef vi4  Type; };
+    template <> struct Mask<vf8>  { typedef vi8  Type; };
+    template <> struct Mask<vf16> { typedef vi16 Type; };
+
+    // always inlined, so that inside a target("avx2") function the vectors
+    // are compiled for that instruction set
+    #define ACTIVATIONS_INLINE static inline __attribute__((always_inline))
+
+    template <class VF> ACTIVATIONS_INLINE VF select(typename Mask<VF>::Type m, VF a, VF b) {
+        typedef typename Mask<VF>::Type VI;
+        return (VF) (((VI) a & m) | ((VI) b & ~m));
+    }
+
+    template <class VF> ACTIVATIONS_INLINE VF vmin(VF a, VF b) {return select<VF>(a < b, a, b);}
+    template <class VF> ACTIVATIONS_INLINE VF vmax(VF a, VF b) {return select<VF>(a > b, a, b);}
+
+    template <class VF> ACTIVATIONS_INLINE VF vabs(VF x) {
+        typedef typename Mask<VF>::Type VI;
+        return (VF) ((VI) x & 0x7fffffff);
+    }
+
+    // cephes expf: x = n ln2 + r, degree 6 polynomial for exp(r), scaled by 2^n
+    template <class VF> ACTIVATIONS_INLINE VF vexp(VF x) {
+        typedef typename Mask<VF>::Type VI;
+        x = vmin<VF>(vmax<VF>(x, VF() - 87.3f), VF() + 88.3f);
+
+        VF m = x * 1.44269504088896341f + 12582912.0f;       // round to nearest, n in the low mantissa bits
+        VF n = m - 12582912.0f;
+        VI ni = (VI) m - 0x4B400000;
+
+        VF r = x - n * 0.693359375f;
+        r = r - n * -2.12194440e-4f;
+
+        VF p = VF() + 1.9875691500E-4f;
+        p = p * r + 1.3981999507E-3f;
+        p = p * r + 8.3334519073E-3f;
+        p = p * r + 4.1665795894E-2f;
+        p = p * r + 1.6666665459E-1f;
+        p = p * r + 5.0000001201E-1f;
+        VF y = p * r * r + r + 1.0f;
+
+        return y * (VF) ((ni + 127) << 23);
+    }
+
+    // cephes logf for x > 0: x = 2^e m with m in [sqrt(1/2), sqrt(2))
+    template <class VF> ACTIVATIONS_INLINE VF vlog(VF x) {
+        typedef typename Mask<VF>::Type VI;
+        VI bits = (VI) x;
+        VI e = ((bits >> 23) & 0xff) - 126;
+        VF m = (VF) ((bits & 0x007fffff) | 0x3f000000);
+
+        VI small = m < 0.707106781186547524f;
+        e = e + small;                                      // masks are -1 where true
+        m = m + select<VF>(small, m, VF()) - 1.0f;
+        VF ef = (VF) (e + 0x4B400000) - 12582912.0f;
+
+        VF z = m * m;
+        VF p = VF() + 7.0376836292E-2f;
+        p = p * m - 1.1514610310E-1f;
+        p = p * m + 1.1676998740E-1f;
+        p = p * m - 1.2420140846E-1f;
+        p = p * m + 1.4249322787E-1f;
+        p = p * m - 1.6668057665E-1f;
+        p = p * m + 2.0000714765E-1f;
+        p = p * m - 2.4999993993E-1f;
+        p = p * m + 3.3333331174E-1f;
+
+        VF y = p * m * z;
+        y = y + ef * -2.12194440e-4f;
+        y = y - 0.5f * z;
+        return m + y + ef * 0.693359375f;
+    }
+
+    // sin(x) reduced to r in [-pi, pi], then |r| folded onto [0, pi/2]
+    template <class VF> ACTIVATIONS_INLINE VF vsin(VF x) {
+        typedef typename Mask<VF>::Type VI;
+        VF k = (x * 0.159154943091895336f + 12582912.0f) - 12582912.0f;
+        VF r = (x - k * 6.28125f) - k * 1.93530717958647692e-3f;
+
+        VF a = vabs<VF>(r);
+        a = vmin<VF>(a, 3.14159265358979324f - a);
+
+        VF a2 = a * a;
+        VF p = VF() - 2.50521083854417188e-8f;
+        p = p * a2 + 2.75573192239858907e-6f;
+        p = p * a2 - 1.98412698412698413e-4f;
+        p = p * a2 + 8.33333333333333333e-3f;
+        p = p * a2 - 1.66666666666666667e-1f;
+        VF s = a + a * a2 * p;
+
+        // s is slightly negative when rounding left |r| just above pi
+        return (VF) ((VI) s ^ ((VI) r & (int32_t) 0x80000000));
+    }
+
+    // 0.5 x (1 + erf(x / sqrt(2))), erf from Abramowitz & Stegun 7.1.26
+    template <class VF> ACTIVATIONS_INLINE VF vgelu(VF x) {
+        typedef typename Mask<VF>::Type VI;
+        VF z = vabs<VF>(x) * 0.707106781186547524f;
+        VF t = 1.0f / (1.0f + 0.3275911f * z);
+
+        VF p = VF() + 1.061405429f;
+        p = p * t - 1.453152027f;
+        p = p * t + 1.421413741f;
+        p = p * t - 0.284496736f;
+        p = p * t + 0.254829592f;
+        VF erf = 1.0f - p * t * vexp<VF>(-z * z);
+
+        erf = (VF) ((VI) erf | ((VI) x & (int32_t) 0x80000000));
+        return 0.5f * x * (1.0f + erf);
+    }
+
+    template <class VF> ACTIVATIONS_INLINE VF apply(VF x, Type act) {
+        switch (act) {
+            case Linear:        return x;
+            case LeakyReLU:     return vmax<VF>(x, 0.2f * x);
+            case Tanh:          x = vmin<VF>(vmax<VF>(x, VF() - 9.0f), VF() + 9.0f);
+                                return 1.0f - 2.0f / (vexp<VF>(2.0f * x) + 1.0f);
+            case Sigmoid:       return 1.0f / (1.0f + vexp<VF>(-x));
+            case ReLU:          return vmax<VF>(x, VF());
+            case ELU:           return select<VF>(x > 0.0f, x, vexp<VF>(x) - 1.0f);
+            case SELU:          return 1.0507009873554805f * select<VF>(x > 0.0f, x, 1.6732632423543772f * (vexp<VF>(x) - 1.0f));
+            case GELU:          return vgelu<VF>(x);
+            case RReLU:         return vmax<VF>(x, (11.0f / 48.0f) * x);       // eval slope (1/8 + 1/3) / 2
+            case Softplus:      return vmax<VF>(x, VF()) + vlog<VF>(1.0f + vexp<VF>(-vabs<VF>(x)));
+            case Softshrink:    return x - vmin<VF>(vmax<VF>(x, VF() - 0.5f), VF() + 0.5f);
+            case Sine:          return vsin<VF>(x);
+            case Sine30:        return vsin<VF>(30.0f * x);
+            default:            return x;
+        }
+    }
+
+    #undef ACTIVATIONS_INLINE
+
+    // in place over a row of frames
+    inline void apply(float* x, int n, Type act) {
+        if (act == Linear)
+            return;
+
+        int t = 0;
+        for (; t + 4 <= n; t += 4) {
+            vf4 v;
+            std::memcpy(&v, x + t, sizeof(v));
+            v = apply<vf4>(v, act);
+            std::memcpy(x + t, &v, sizeof(v));
+        }
+        for (; t < n; t++) {
+            vf1 v = {x[t]};
+            x[t] = apply<vf1>(v, act)[0];
+        }
+    }
+
+ #if defined(__GNUC__) && !defined(__clang__)
+  #pragma GCC diagnostic pop
+ #endif
+
+#else
+
+    // compilers without vector extensions use the libm functions
+    inline float apply(float x, Type act) {
+        switch (act) {
+            case LeakyReLU:     return x > 0.0f ? x : 0.2f * x;
+            case Tanh:          return std::tanh(x);
+            case Sigmoid:       return 1.0f / (1.0f + std::exp(-x));
+            case ReLU:          return x > 0.0f ? x : 0.0f;
+            case ELU:           return x > 0.0f ? x : std::expm1(x);
+            case SELU:          return 1.0507009873554805f * (x > 0.0f ? x : 1.6732632423543772f * std::expm1(x));
+            case GELU:          return 0.5f * x * (1.0f + std::erf(x * 0.707106781186547524f));
+            case RReLU:         return x > 0.0f ? x : (11.0f / 48.0f) * x;
+            case Softplus:      return x > 20.0f ? x : std::log1p(std::exp(x));
+            case Softshrink:    return x > 0.5f ? x - 0.5f : (x < -0.5f ? x + 0.5f : 0.0f);
+            case Sine:          return std::sin(x);
+            case Sine30:        return std::sin(30.0f * x);
+            default:            return x;
+        }
+    }
+
+    inline void apply(float* x, int n, Type act) {
+        for (int t = 0; t < n; t++)
+            x[t] = apply(x[t], act);
+    }
+
+#endif
+
+}
+
+#endif
@@ -0,0 +1,1619 @@
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+
+#include "conv1d.h"
+
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+ #define CONV1D_X86 1
+ #include <immintrin.h>
+ #if !defined(__clang__)
+  #pragma GCC diagnostic ignored "-Wpsabi"     // AVX vectors only cross function boundaries inside the target("avx2") tiles
+ #endif
+#else
+ #define CONV1D_X86 0
+#endif
+
+Conv1dKernel::Conv1dKernel() {
+    isa = detectISA();
+    activation = activations::Linear;
+    precision = Float32;
+    sparse = false;
+    separable = false;
+    inputGain = outputGain = 1.0f;
+    setup(1, 1, 1, 1, 1, false);
+}
+
+void Conv1dKernel::setup(int nInputs,
+                         int nOutputs,
+                         int kWidth,
+                         int dFactor,
+                         int nGroups,
+                         bool useBias,
+                         bool isSeparable) {
+    inChannels = nInputs;
+    outChannels = nOutputs;
+    kernelWidth = kWidth;
+    dilation = dFactor;
+    separable = isSeparable;
+    groups = separable ? 1 : nGroups;
+    bias = useBias;
+
+    // grouped convolutions read a different set of inputs for every
+    // output channel, so those are computed one output at a time
+    tileWidth = (groups == 1) ? 4 : 1;
+
+    // a separable layer's mix is packed like a dense layer of width 1, its taps follow
+    int tiles = (outChannels + tileWidth - 1) / tileWidth;
+    depthwiseOffset = tiles * inChannels * tileWidth;
+    if (separable)
+        packedWeights.assign(depthwiseOffset + inChannels * kernelWidth, 0.0f);
+    else
+        packedWeights.assign(tiles * (inChannels / groups) * kernelWidth * tileWidth, 0.0f);
+    packedBias.assign(tiles * tileWidth, 0.0f);
+    packedScale.assign(tiles * tileWidth, 1.0f);
+    packedShift.assign(tiles * tileWidth, 0.0f);
+    scaled = false;
+    residual = false;
+    residualOffset = getContext() / 2;
+    clearMorph();
+    inputGain = outputGain = 1.0f;
+    unitWeights.clear();
+    unitBias.clear();
+    unitShift.clear();
+
+    // a new shape starts dense and in float, both need weights
+    precision = Float32;
+    sparse = false;
+    prunedBlocks.clear();
+    selectTiles();
+}
+
+void Conv1dKernel::packWeights(const float* weight, const float* b, const float* mix) {
+    int inPerGroup = inChannels / groups;
+    int K = separable ? 1 : kernelWidth;
+    clearMorph();
+    dropSparse();
+    prunedBlocks.clear();
+    std::fill(packedWeights.begin(), packedWeights.end(), 0.0f);
+    std::fill(packedBias.begin(), packedBias.end(), 0.0f);
+    if (separable) {
+        std::copy(weight, weight + inChannels * kernelWidth, packedWeights.begin() + depthwiseOffset);
+        weight = mix;
+    }
+
+    for (int o = 0; o < outChannels; o++) {
+        int tile = o / tileWidth;
+        int lane = o % tileWidth;
+        for (int c = 0; c < inPerGroup; c++) {
+            for (int j = 0; j < K; j++) {
+                int src = (o * inPerGroup + c) * K + j;
+                int dst = ((tile * inPerGroup + c) * K + j) * tileWidth + lane;
+                packedWeights[dst] = weight[src];
+            }
+        }
+        if (bias && b != nullptr)
+            packedBias[o] = b[o];
+    }
+    refreshGains();
+    if (precision != Float32)
+        quantiseWeights();
+}
+
+void Conv1dKernel::setOutputScale(const float* scale, const float* shift) {
+    scaled = (scale != nullptr && shift != nullptr);
+    for (int o = 0; o < outChannels; o++) {
+        packedScale[o] = scaled ? scale[o] : 1.0f;
+        packedShift[o] = scaled ? outputGain * shift[o] : 0.0f;
+        if (!unitShift.empty())
+            unitShift[o] = scaled ? shift[o] : 0.0f;
+    }
+}
+
+void Conv1dKernel::setResidual(bool enabled) {
+    residual = enabled && canAddResidual();
+}
+
+bool Conv1dKernel::setGains(float newInputGain, float newOutputGain) {
+    bool exact = !residual || (newInputGain == 1.0f && newOutputGain == 1.0f);
+    if (!exact)
+        newInputGain = newOutputGain = 1.0f;
+
+    if (unitWeights.empty()) {
+        unitWeights = packedWeights;
+        unitBias = packedBias;
+        unitShift = packedShift;
+    }
+    if (newInputGain != inputGain || newOutputGain != outputGain) {
+        inputGain = newInputGain;
+        outputGain = newOutputGain;
+        applyGains();
+        if (precision != Float32)
+            quantiseWeights();
+    }
+    return exact;
+}
+
+// packed weights, biases and FiLM shifts from their unit gain copies. the mix of
+// a separable layer takes both gains, its depthwise taps stay as they are
+void Conv1dKernel::applyGains() {
+    if (unitWeights.empty())
+        return;
+    const float w = inputGain * outputGain;
+    const size_t scaledWeights = separable ? (size_t) depthwiseOffset : packedWeights.size();
+    for (size_t i = 0; i < packedWeights.size(); i++)
+        packedWeights[i] = (i < scaledWeights ? w : 1.0f) * unitWeights[i];
+    for (size_t o = 0; o < packedBias.size(); o++) {
+        packedBias[o] = outputGain * unitBias[o];
+        packedShift[o] = outputGain * unitShift[o];
+    }
+
+    copySparse();
+}
+
+// the sparse loops read their own copy of the blocks that are left
+void Conv1dKernel::copySparse() {
+    const int K = separable ? 1 : kernelWidth;
+    for (int tile = 0; sparse && tile + 1 < (int) sparseStart.size(); tile++) {
+        for (int e = sparseStart[tile]; e < sparseStart[tile + 1]; e++) {
+            int b = (tile * inChannels + sparseIndex[2 * e]) * K + sparseIndex[2 * e + 1] / dilation;
+            std::copy(packedWeights.begin() + b * 4, packedWeights.begin() + b * 4 + 4, sparseWeights.begin() + e * 4);
+        }
+    }
+}
+
+// new unit gain weights in packedWeights and packedBias
+void Conv1dKernel::refreshGains() {
+    if (unitWeights.empty()) {
+        copySparse();
+        return;
+    }
+    unitWeights = packedWeights;
+    unitBias = packedBias;
+    applyGains();
+}
+
+bool Conv1dKernel::setMorphTarget(const Conv1dKernel& target) {
+    clearMorph();
+    if (target.inChannels != inChannels || target.outChannels != outChannels || target.kernelWidth != kernelWidth
+        || target.groups != groups || target.separable != separable || target.packedWeights.size() != packedWeights.size())
+        return false;
+
+    // both ends at unit gain, the gains go on top of whatever the morph makes
+    const Conv1dKernel* ends[2] = {this, &target};
+    for (int e = 0; e < 2; e++) {
+        morphEnds[e] = ends[e]->getUnitWeights();
+        morphEnds[e].insert(morphEnds[e].end(), ends[e]->getUnitBias().begin(), ends[e]->getUnitBias().end());
+    }
+    morphWeights = packedWeights;
+    morphBias = packedBias;
+    measureMorph();
+    return true;
+}
+
+// blocks that were pruned stay zero at both ends, so the morph keeps the sparse loops
+void Conv1dKernel::measureMorph() {
+    for (size_t b = 0; b < prunedBlocks.size(); b++) {
+        if (prunedBlocks[b] == 0)
+            continue;
+        for (auto& end : morphEnds)
+            std::fill(end.begin() + b * 4, end.begin() + b * 4 + 4, 0.0f);
+    }
+
+    morphDot = morphNorms[0] = morphNorms[1] = 0.0;
+    for (size_t i = 0; i < morphEnds[0].size(); i++) {
+        morphDot += (double) morphEnds[0][i] * morphEnds[1][i];
+        morphNorms[0] += (double) morphEnds[0][i] * morphEnds[0][i];
+        morphNorms[1] += (double) morphEnds[1][i] * morphEnds[1][i];
+    }
+    morphNorms[0] = std::sqrt(morphNorms[0]);
+    morphNorms[1] = std::sqrt(morphNorms[1]);
+}
+
+void Conv1dKernel::clearMorph() {
+    for (auto& end : morphEnds)
+        end.clear();
+    morphWeights.clear();
+    morphBias.clear();
+}
+
+// y = a * x0 + b * x1, eight at a time
+static void interpolate(const float* x0, const float* x1, float a, float b, float* y, int n) {
+    int i = 0;
+#if defined(__GNUC__) || defined(__clang__)
+    using activations::vf4;
+    for (; i + 8 <= n; i += 8) {
+        vf4 p0, p1, q0, q1;
+        std::memcpy(&p0, x0 + i, sizeof(p0));
+        std::memcpy(&p1, x0 + i + 4, sizeof(p1));
+        std::memcpy(&q0, x1 + i, sizeof(q0));
+        std::memcpy(&q1, x1 + i + 4, sizeof(q1));
+        p0 = a * p0 + b * q0;
+        p1 = a * p1 + b * q1;
+        std::memcpy(y + i, &p0, sizeof(p0));
+        std::memcpy(y + i + 4, &p1, sizeof(p1));
+    }
+#endif
+    for (; i < n; i++)
+        y[i] = a * x0[i] + b * x1[i];
+}
+
+// weights [start, start + numWeights) of the packed weights followed by the biases
+void Conv1dKernel::morph(float a, float b, int start, int numWeights) {
+    int end = std::min(start + numWeights, getMorphSize());
+    int split = (int) morphWeights.size();
+    if (start < split) {
+        int n = std::min(end, split) - start;
+        interpolate(morphEnds[0].data() + start, morphEnds[1].data() + start, a, b, morphWeights.data() + start, n);
+        start += n;
+    }
+    if (start < end)
+        interpolate(morphEnds[0].data() + start, morphEnds[1].data() + start, a, b, morphBias.data() + start - split, end - start);
+}
+
+void Conv1dKernel::swapMorph() {
+    packedWeights.swap(morphWeights);
+    packedBias.swap(morphBias);
+    refreshGains();
+    if (precision != Float32)
+        quantiseWeights();
+}
+
+void Conv1dKernel::setISA(ISA newISA) {
+    // never select an instruction set the cpu can't run
+    isa = std::min(newISA, detectISA());
+    selectTiles();
+}
+
+Conv1dKernel::ISA Conv1dKernel::detectISA() {
+#if CONV1D_X86
+    static const ISA best = [] {
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("avx512f"))
+            return AVX512;
+        if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma"))
+            return AVX2;
+        return Scalar;
+    }();
+    return best;
+#else
+    return Scalar;
+#endif
+}
+
+const char* Conv1dKernel::getISAName(ISA isa) {
+    switch (isa) {
+        case AVX2:      return "avx2";
+        case AVX512:    return "avx512";
+        default:        return "scalar";
+    }
+}
+
+//==============================================================================
+// The tile loops below are templates on the kernel width and the number of
+// input channels. With both fixed at compile time the tap loops unroll and
+// the weight offsets become constants, <0, 0> is the generic runtime version.
+
+// FiLM, activation and residual on m accumulated frames of output o, stored at y + t
+static inline void finishScalar(const Conv1dKernel& k, float* acc, int m, int o, const float* in, int inStride, float* y, int t) {
+    if (k.scaled) {
+        for (int u = 0; u < m; u++)
+            acc[u] = k.packedScale[o] * acc[u] + k.packedShift[o];
+    }
+    activations::apply(acc, m, k.activation);
+    if (k.residual) {
+        const float* skip = in + (k.inChannels == 1 ? 0 : o) * inStride + k.residualOffset + t;
+        for (int u = 0; u < m; u++)
+            acc[u] += skip[u];
+    }
+    for (int u = 0; u < m; u++)
+        y[t + u] = acc[u];
+}
+
+// frames [t0, t1) of a single output tile, used on its own by the scalar
+// path and for the frames left over after the SIMD loops
+template <int FixedK, int FixedC>
+static void processTileScalar(const Conv1dKernel& k,
+                              const float* in, int inStride,
+                              float* const* rows,
+                              int tile, int t0, int t1) {
+    const int K = FixedK > 0 ? FixedK : k.kernelWidth;
+    const int inPerGroup = FixedC > 0 ? FixedC : k.inChannels / k.groups;
+    const int outPerGroup = k.outChannels / k.groups;
+    const float* w = k.packedWeights.data() + tile * inPerGroup * K * k.tileWidth;
+
+    for (int lane = 0; lane < k.tileWidth; lane++) {
+        int o = tile * k.tileWidth + lane;
+        if (o >= k.outChannels)
+            break;
+
+        const float* x = in + (o / outPerGroup) * inPerGroup * inStride;
+        float* y = rows[lane];
+        if (y == nullptr)
+            continue;
+
+        // accumulate blocks of frames in a local array the compiler can keep
+        // in vector registers, since it can't tell that y and x don't overlap
+        for (int t = t0; t < t1; t += 16) {
+            const int m = std::min(16, t1 - t);
+            float acc[16];
+            for (int u = 0; u < 16; u++)
+                acc[u] = k.packedBias[o];
+
+            for (int c = 0; c < inPerGroup; c++) {
+                for (int j = 0; j < K; j++) {
+                    const float wv = w[(c * K + j) * k.tileWidth + lane];
+                    const float* xr = x + c * inStride + j * k.dilation + t;
+                    if (m == 16) {
+                        for (int u = 0; u < 16; u++)
+                            acc[u] += wv * xr[u];
+                    }
+                    else {
+                        for (int u = 0; u < m; u++)
+                            acc[u] += wv * xr[u];
+                    }
+                }
+            }
+            finishScalar(k, acc, m, o, in, inStride, y, t);
+        }
+    }
+}
+
+// frames [t0, t1) of a pruned tile, only the blocks left in the sparse index
+static void processTileSparseScalar(const Conv1dKernel& k,
+                                    const float* in, int inStride,
+                                    float* const* rows,
+                                    int tile, int t0, int t1) {
+    const int first = k.sparseStart[tile], last = k.sparseStart[tile + 1];
+    const int32_t* index = k.sparseIndex.data();
+    const float* w = k.sparseWeights.data();
+
+    for (int lane = 0; lane < 4; lane++) {
+        int o = tile * 4 + lane;
+        float* y = rows[lane];
+        if (o >= k.outChannels || y == nullptr)
+            continue;
+
+        for (int t = t0; t < t1; t += 16) {
+            const int m = std::min(16, t1 - t);
+            float acc[16];
+            for (int u = 0; u < 16; u++)
+                acc[u] = k.packedBias[o];
+
+            for (int e = first; e < last; e++) {
+                const float wv = w[e * 4 + lane];
+                if (wv == 0.0f)
+                    continue;
+                const float* xr = in + index[2 * e] * inStride + index[2 * e + 1] + t;
+                for (int u = 0; u < m; u++)
+                    acc[u] += wv * xr[u];
+            }
+            finishScalar(k, acc, m, o, in, inStride, y, t);
+        }
+    }
+}
+
+// Depthwise-separable layers run in passes of separableFrames frames. The depthwise
+// taps of every input channel go into the mid rows first, which stay in L1 while
+// each tile of outputs mixes them. The epilogue still reads the layer input for the
+// residual, the mix only replaces the input channels the outputs accumulate.
+
+// the depthwise taps of numFrames frames into mid, padded with zeros to a whole vector
+static void depthwiseScalar(const Conv1dKernel& k, const float* in, int inStride, float* mid, int numFrames) {
+    const int K = k.kernelWidth;
+    const float* w = k.packedWeights.data() + k.depthwiseOffset;
+
+    for (int c = 0; c < k.inChannels; c++, w += K) {
+        const float* x = in + c * inStride;
+        float* y = mid + c * Conv1dKernel::separableFrames;
+        for (int t = 0; t < numFrames; t += 16) {
+            const int m = std::min(16, numFrames - t);
+            float acc[16] = {};
+            for (int j = 0; j < K; j++) {
+                const float* xr = x + j * k.dilation + t;
+                for (int u = 0; u < m; u++)
+                    acc[u] += w[j] * xr[u];
+            }
+            std::copy(acc, acc + 16, y + t);
+        }
+    }
+}
+
+static void mixTileScalar(const Conv1dKernel& k, const float* mid, const float* in, int inStride,
+                          float* const* rows, int tile, int numFrames) {
+    const float* w = k.packedWeights.data() + tile * k.inChannels * 4;
+
+    for (int lane = 0; lane < 4; lane++) {
+        int o = tile * 4 + lane;
+        float* y = rows[lane];
+        if (o >= k.outChannels || y == nullptr)
+            continue;
+
+        for (int t = 0; t < numFrames; t += 16) {
+            const int m = std::min(16, numFrames - t);
+            float acc[16];
+            for (int u = 0; u < 16; u++)
+                acc[u] = k.packedBias[o];
+            for (int c = 0; c < k.inChannels; c++) {
+                const float wv = w[c * 4 + lane];
+                const float* xr = mid + c * Conv1dKernel::separableFrames + t;
+                for (int u = 0; u < 16; u++)
+                    acc[u] += wv * xr[u];
+            }
+            finishScalar(k, acc, m, o, in, inStride, y, t);
+        }
+    }
+}
+
+// a pruned mix only visits the input channels its tile kept
+static void mixTileSparseScalar(const Conv1dKernel& k, const float* mid, const float* in, int inStride,
+                                float* const* rows, int tile, int numFrames) {
+    const int first = k.sparseStart[tile], last = k.sparseStart[tile + 1];
+
+    for (int lane = 0; lane < 4; lane++) {
+        int o = tile * 4 + lane;
+        float* y = rows[lane];
+        if (o >= k.outChannels || y == nullptr)
+            continue;
+
+        for (int t = 0; t < numFrames; t += 16) {
+            const int m = std::min(16, numFrames - t);
+            float acc[16];
+            for (int u = 0; u < 16; u++)
+                acc[u] = k.packedBias[o];
+            for (int e = first; e < last; e++) {
+                const float wv = k.sparseWeights[e * 4 + lane];
+                const float* xr = mid + k.sparseIndex[2 * e] * Conv1dKernel::separableFrames + t;
+                for (int u = 0; u < 16; u++)
+                    acc[u] += wv * xr[u];
+            }
+            finishScalar(k, acc, m, o, in, inStride, y, t);
+        }
+    }
+}
+
+#if CONV1D_X86
+using activations::vf8;
+using activations::vf16;
+
+// input row added to output o by a residual connection
+static inline int skipRow(const Conv1dKernel& k, int o) {
+    return k.inChannels == 1 ? 0 : o;
+}
+
+// the float epilogue on n <= 8 frames of output o starting at frame t
+__attribute__((target("avx2,fma")))
+static inline void finishAVX2(const Conv1dKernel& k, __m256 y, int o, const float* in, int inStride, float* row, int t, int n) {
+    const __m256i m = _mm256_cmpgt_epi32(_mm256_set1_epi32(n), _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7));
+    if (k.scaled)
+        y = _mm256_fmadd_ps(_mm256_set1_ps(k.packedScale[o]), y, _mm256_set1_ps(k.packedShift[o]));
+    y = (__m256) activations::apply<vf8>((vf8) y, k.activation);
+    if (k.residual) {
+        const float* skip = in + skipRow(k, o) * inStride + k.residualOffset + t;
+        y = _mm256_add_ps(y, n == 8 ? _mm256_loadu_ps(skip) : _mm256_maskload_ps(skip, m));
+    }
+    if (n == 8)
+        _mm256_storeu_ps(row + t, y);
+    else
+        _mm256_maskstore_ps(row + t, m, y);
+}
+
+__attribute__((target("avx512f")))
+static inline void finishAVX512(const Conv1dKernel& k, __m512 y, int o, const float* in, int inStride, float* row, int t, __mmask16 m) {
+    if (k.scaled)
+        y = _mm512_fmadd_ps(_mm512_set1_ps(k.packedScale[o]), y, _mm512_set1_ps(k.packedShift[o]));
+    y = (__m512) activations::apply<vf16>((vf16) y, k.activation);
+    if (k.residual)
+        y = _mm512_add_ps(y, _mm512_maskz_loadu_ps(m, in + skipRow(k, o) * inStride + k.residualOffset + t));
+    _mm512_mask_storeu_ps(row + t, m, y);
+}
+
+static inline __mmask16 frameMask(int n) {
+    return n >= 16 ? (__mmask16) 0xFFFF : n <= 0 ? (__mmask16) 0 : (__mmask16) ((1u << n) - 1);
+}
+
+// the activation is applied to the accumulators while they are still in
+// registers, the vector code in activations.h inlines into each target
+template <int FixedK, int FixedC>
+__attribute__((target("avx2,fma")))
+static int processTileAVX2(const Conv1dKernel& k,
+                           const float* in, int inStride,
+                           float* const* rows,
+                           int tile, int numFrames) {
+    const int K = FixedK > 0 ? FixedK : k.kernelWidth;
+    const int C = FixedC > 0 ? FixedC : k.inChannels;
+    const int D = k.dilation;
+    const float* w = k.packedWeights.data() + tile * C * K * 4;
+    const float* b = k.packedBias.data() + tile * 4;
+    const float* s = k.packedScale.data() + tile * 4;
+    const float* h = k.packedShift.data() + tile * 4;
+
+    int t = 0;
+    for (; t + 16 <= numFrames; t += 16) {
+        __m256 acc[4][2];
+        for (int q = 0; q < 4; q++)
+            acc[q][0] = acc[q][1] = _mm256_broadcast_ss(b + q);
+
+        const float* wp = w;
+        for (int c = 0; c < C; c++) {
+            const float* x = in + c * inStride + t;
+            for (int j = 0; j < K; j++, wp += 4) {
+                __m256 x0 = _mm256_loadu_ps(x + j * D);
+                __m256 x1 = _mm256_loadu_ps(x + j * D + 8);
+                for (int q = 0; q < 4; q++) {
+                    __m256 wq = _mm256_broadcast_ss(wp + q);
+                    acc[q][0] = _mm256_fmadd_ps(wq, x0, acc[q][0]);
+                    acc[q][1] = _mm256_fmadd_ps(wq, x1, acc[q][1]);
+                }
+            }
+        }
+        for (int q = 0; q < 4; q++) {
+            if (rows[q] == nullptr)
+                continue;
+            if (k.scaled) {
+                acc[q][0] = _mm256_fmadd_ps(_mm256_broadcast_ss(s + q), acc[q][0], _mm256_broadcast_ss(h + q));
+                acc[q][1] = _mm256_fmadd_ps(_mm256_broadcast_ss(s + q), acc[q][1], _mm256_broadcast_ss(h + q));
+            }
+            acc[q][0] = (__m256) activations::apply<vf8>((vf8) acc[q][0], k.activation);
+            acc[q][1] = (__m256) activations::apply<vf8>((vf8) acc[q][1], k.activation);
+            if (k.residual) {
+                const float* skip = in + skipRow(k, tile * 4 + q) * inStride + k.residualOffset + t;
+                acc[q][0] = _mm256_add_ps(acc[q][0], _mm256_loadu_ps(skip));
+                acc[q][1] = _mm256_add_ps(acc[q][1], _mm256_loadu_ps(skip + 8));
+            }
+            _mm256_storeu_ps(rows[q] + t, acc[q][0]);
+            _mm256_storeu_ps(rows[q] + t + 8, acc[q][1]);
+        }
+    }
+    for (; t + 8 <= numFrames; t += 8) {
+        __m256 acc[4];
+        for (int q = 0; q < 4; q++)
+            acc[q] = _mm256_broadcast_ss(b + q);
+
+        const float* wp = w;
+        for (int c = 0; c < C; c++) {
+            const float* x = in + c * inStride + t;
+            for (int j = 0; j < K; j++, wp += 4) {
+                __m256 x0 = _mm256_loadu_ps(x + j * D);
+                for (int q = 0; q < 4; q++)
+                    acc[q] = _mm256_fmadd_ps(_mm256_broadcast_ss(wp + q), x0, acc[q]);
+            }
+        }
+        for (int q = 0; q < 4; q++) {
+            if (rows[q] == nullptr)
+                continue;
+            if (k.scaled)
+                acc[q] = _mm256_fmadd_ps(_mm256_broadcast_ss(s + q), acc[q], _mm256_broadcast_ss(h + q));
+            acc[q] = (__m256) activations::apply<vf8>((vf8) acc[q], k.activation);
+            if (k.residual)
+                acc[q] = _mm256_add_ps(acc[q], _mm256_loadu_ps(in + skipRow(k, tile * 4 + q) * inStride + k.residualOffset + t));
+            _mm256_storeu_ps(rows[q] + t, acc[q]);
+        }
+    }
+    return t;
+}
+
+template <int FixedK, int FixedC>
+__attribute__((target("avx512f")))
+static int processTileAVX512(const Conv1dKernel& k,
+                             const float* in, int inStride,
+                             float* const* rows,
+                             int tile, int numFrames) {
+    const int K = FixedK > 0 ? FixedK : k.kernelWidth;
+    const int C = FixedC > 0 ? FixedC : k.inChannels;
+    const int D = k.dilation;
+    const float* w = k.packedWeights.data() + tile * C * K * 4;
+    const float* b = k.packedBias.data() + tile * 4;
+    const float* s = k.packedScale.data() + tile * 4;
+    const float* h = k.packedShift.data() + tile * 4;
+
+    int t = 0;
+    for (; t + 32 <= numFrames; t += 32) {
+        __m512 acc[4][2];
+        for (int q = 0; q < 4; q++)
+            acc[q][0] = acc[q][1] = _mm512_set1_ps(b[q]);
+
+        const float* wp = w;
+        for (int c = 0; c < C; c++) {
+            const float* x = in + c * inStride + t;
+            for (int j = 0; j < K; j++, wp += 4) {
+                __m512 x0 = _mm512_loadu_ps(x + j * D);
+                __m512 x1 = _mm512_loadu_ps(x + j * D + 16);
+                for (int q = 0; q < 4; q++) {
+                    __m512 wq = _mm512_set1_ps(wp[q]);
+                    acc[q][0] = _mm512_fmadd_ps(wq, x0, acc[q][0]);
+                    acc[q][1] = _mm512_fmadd_ps(wq, x1, acc[q][1]);
+                }
+            }
+        }
+        for (int q = 0; q < 4; q++) {
+            if (rows[q] == nullptr)
+                continue;
+            if (k.scaled) {
+                acc[q][0] = _mm512_fmadd_ps(_mm512_set1_ps(s[q]), acc[q][0], _mm512_set1_ps(h[q]));
+                acc[q][1] = _mm512_fmadd_ps(_mm512_set1_ps(s[q]), acc[q][1], _mm512_set1_ps(h[q]));
+            }
+            acc[q][0] = (__m512) activations::apply<vf16>((vf16) acc[q][0], k.activation);
+            acc[q][1] = (__m512) activations::apply<vf16>((vf16) acc[q][1], k.activation);
+            if (k.residual) {
+                const float* skip = in + skipRow(k, tile * 4 + q) * inStride + k.residualOffset + t;
+                acc[q][0] = _mm512_add_ps(acc[q][0], _mm512_loadu_ps(skip));
+                acc[q][1] = _mm512_add_ps(acc[q][1], _mm512_loadu_ps(skip + 16));
+            }
+            _mm512_storeu_ps(rows[q] + t, acc[q][0]);
+            _mm512_storeu_ps(rows[q] + t + 16, acc[q][1]);
+        }
+    }
+    // the remaining (up to 31) frames use masked loads and stores
+    for (; t < numFrames; t += 16) {
+        __mmask16 m = (numFrames - t >= 16) ? 0xFFFF : (__mmask16) ((1u << (numFrames - t)) - 1);
+        __m512 acc[4];
+        for (int q = 0; q < 4; q++)
+            acc[q] = _mm512_set1_ps(b[q]);
+
+        const float* wp = w;
+        for (int c = 0; c < C; c++) {
+            const float* x = in + c * inStride + t;
+            for (int j = 0; j < K; j++, wp += 4) {
+                __m512 x0 = _mm512_maskz_loadu_ps(m, x + j * D);
+                for (int q = 0; q < 4; q++)
+                    acc[q] = _mm512_fmadd_ps(_mm512_set1_ps(wp[q]), x0, acc[q]);
+            }
+        }
+        for (int q = 0; q < 4; q++) {
+            if (rows[q] == nullptr)
+                continue;
+            if (k.scaled)
+                acc[q] = _mm512_fmadd_ps(_mm512_set1_ps(s[q]), acc[q], _mm512_set1_ps(h[q]));
+            acc[q] = (__m512) activations::apply<vf16>((vf16) acc[q], k.activation);
+            if (k.residual)
+                acc[q] = _mm512_add_ps(acc[q], _mm512_maskz_loadu_ps(m, in + skipRow(k, tile * 4 + q) * inStride + k.residualOffset + t));
+            _mm512_mask_storeu_ps(rows[q] + t, m, acc[q]);
+        }
+    }
+    return numFrames;
+}
+
+// two lanes through the same tile, each weight broadcast feeds two vectors of frames of
+// both. AVX2 has no such loop, its 16 registers already go on one lane's accumulators
+template <int FixedK, int FixedC>
+__attribute__((target("avx512f")))
+static int processTilePairAVX512(const Conv1dKernel& k,
+                                 const float* const* in, int inStride,
+                                 float* const* const* rows,
+                                 int tile, int numFrames) {
+    const int K = FixedK > 0 ? FixedK : k.kernelWidth;
+    const int C = FixedC > 0 ? FixedC : k.inChannels;
+    const int D = k.dilation;
+    const float* w = k.packedWeights.data() + tile * C * K * 4;
+    const float* b = k.packedBias.data() + tile * 4;
+
+    int t = 0;
+    for (; t + 32 <= numFrames; t += 32) {
+        __m512 acc[2][4][2];
+        for (int q = 0; q < 4; q++)
+            acc[0][q][0] = acc[0][q][1] = acc[1][q][0] = acc[1][q][1] = _mm512_set1_ps(b[q]);
+
+        const float* wp = w;
+        for (int c = 0; c < C; c++) {
+            const float* x0 = in[0] + c * inStride + t;
+            const float* x1 = in[1] + c * inStride + t;
+            for (int j = 0; j < K; j++, wp += 4) {
+                __m512 a00 = _mm512_loadu_ps(x0 + j * D), a01 = _mm512_loadu_ps(x0 + j * D + 16);
+                __m512 a10 = _mm512_loadu_ps(x1 + j * D), a11 = _mm512_loadu_ps(x1 + j * D + 16);
+                for (int q = 0; q < 4; q++) {
+                    __m512 wq = _mm512_set1_ps(wp[q]);
+                    acc[0][q][0] = _mm512_fmadd_ps(wq, a00, acc[0][q][0]);
+                    acc[0][q][1] = _mm512_fmadd_ps(wq, a01, acc[0][q][1]);
+                    acc[1][q][0] = _mm512_fmadd_ps(wq, a10, acc[1][q][0]);
+                    acc[1][q][1] = _mm512_fmadd_ps(wq, a11, acc[1][q][1]);
+                }
+            }
+        }
+        for (int l = 0; l < 2; l++) {
+            for (int q = 0; q < 4; q++) {
+                if (rows[l][q] == nullptr)
+                    continue;
+                finishAVX512(k, acc[l][q][0], tile * 4 + q, in[l], inStride, rows[l][q], t, 0xFFFF);
+                finishAVX512(k, acc[l][q][1], tile * 4 + q, in[l], inStride, rows[l][q], t + 16, 0xFFFF);
+            }
+        }
+    }
+    for (; t < numFrames; t += 16) {
+        const __mmask16 m = frameMask(numFrames - t);
+        __m512 acc[2][4];
+        for (int q = 0; q < 4; q++)
+            acc[0][q] = acc[1][q] = _mm512_set1_ps(b[q]);
+
+        const float* wp = w;
+        for (int c = 0; c < C; c++) {
+            const float* x0 = in[0] + c * inStride + t;
+            const float* x1 = in[1] + c * inStride + t;
+            for (int j = 0; j < K; j++, wp += 4) {
+                __m512 a0 = _mm512_maskz_loadu_ps(m, x0 + j * D);
+                __m512 a1 = _mm512_maskz_loadu_ps(m, x1 + j * D);
+                for (int q = 0; q < 4; q++) {
+                    __m512 wq = _mm512_set1_ps(wp[q]);
+                    acc[0][q] = _mm512_fmadd_ps(wq, a0, acc[0][q]);
+                    acc[1][q] = _mm512_fmadd_ps(wq, a1, acc[1][q]);
+                }
+            }
+        }
+        for (int l = 0; l < 2; l++) {
+            for (int q = 0; q < 4; q++) {
+                if (rows[l][q] != nullptr)
+                    finishAVX512(k, acc[l][q], tile * 4 + q, in[l], inStride, rows[l][q], t, m);
+            }
+        }
+    }
+    return numFrames;
+}
+
+// pruned tiles run through the blocks of their sparse index instead of every
+// input channel and tap, the frames left over go to processTileSparseScalar
+__attribute__((target("avx2,fma")))
+static int processTileSparseAVX2(const Conv1dKernel& k,
+                                 const float* in, int inStride,
+                                 float* const* rows,
+                                 int tile, int numFrames) {
+    const int first = k.sparseStart[tile], last = k.sparseStart[tile + 1];
+    const int32_t* index = k.sparseIndex.data();
+    const float* w = k.sparseWeights.data();
+
+    int t = 0;
+    for (; t + 16 <= numFrames; t += 16) {
+        __m256 acc[4][2];
+        for (int q = 0; q < 4; q++)
+            acc[q][0] = acc[q][1] = _mm256_broadcast_ss(&k.packedBias[tile * 4 + q]);
+
+        for (int e = first; e < last; e++) {
+            const float* x = in + index[2 * e] * inStride + index[2 * e + 1] + t;
+            __m256 x0 = _mm256_loadu_ps(x);
+            __m256 x1 = _mm256_loadu_ps(x + 8);
+            for (int q = 0; q < 4; q++) {
+                __m256 wq = _mm256_broadcast_ss(w + e * 4 + q);
+                acc[q][0] = _mm256_fmadd_ps(wq, x0, acc[q][0]);
+                acc[q][1] = _mm256_fmadd_ps(wq, x1, acc[q][1]);
+            }
+        }
+        for (int q = 0; q < 4; q++) {
+            if (rows[q] == nullptr)
+                continue;
+            finishAVX2(k, acc[q][0], tile * 4 + q, in, inStride, rows[q], t, 8);
+            finishAVX2(k, acc[q][1], tile * 4 + q, in, inStride, rows[q], t + 8, 8);
+        }
+    }
+    for (; t + 8 <= numFrames; t += 8) {
+        __m256 acc[4];
+        for (int q = 0; q < 4; q++)
+            acc[q] = _mm256_broadcast_ss(&k.packedBias[tile * 4 + q]);
+
+        for (int e = first; e < last; e++) {
+            __m256 x0 = _mm256_loadu_ps(in + index[2 * e] * inStride + index[2 * e + 1] + t);
+            for (int q = 0; q < 4; q++)
+                acc[q] = _mm256_fmadd_ps(_mm256_broadcast_ss(w + e * 4 + q), x0, acc[q]);
+        }
+        for (int q = 0; q < 4; q++) {
+            if (rows[q] != nullptr)
+                finishAVX2(k, acc[q], tile * 4 + q, in, inStride, rows[q], t, 8);
+        }
+    }
+    return t;
+}
+
+__attribute__((target("avx512f")))
+static int processTileSparseAVX512(const Conv1dKernel& k,
+                                   const float* in, int inStride,
+                                   float* const* rows,
+                                   int tile, int numFrames) {
+    const int first = k.sparseStart[tile], last = k.sparseStart[tile + 1];
+    const int32_t* index = k.sparseIndex.data();
+    const float* w = k.sparseWeights.data();
+
+    for (int t = 0; t < numFrames; t += 32) {
+        const __mmask16 m0 = frameMask(numFrames - t), m1 = frameMask(numFrames - t - 16);
+        __m512 acc[4][2];
+        for (int q = 0; q < 4; q++)
+            acc[q][0] = acc[q][1] = _mm512_set1_ps(k.packedBias[tile * 4 + q]);
+
+        for (int e = first; e < last; e++) {
+            const float* x = in + index[2 * e] * inStride + index[2 * e + 1] + t;
+            __m512 x0 = _mm512_maskz_loadu_ps(m0, x);
+            __m512 x1 = _mm512_maskz_loadu_ps(m1, x + 16);
+            for (int q = 0; q < 4; q++) {
+                __m512 wq = _mm512_set1_ps(w[e * 4 + q]);
+                acc[q][0] = _mm512_fmadd_ps(wq, x0, acc[q][0]);
+                acc[q][1] = _mm512_fmadd_ps(wq, x1, acc[q][1]);
+            }
+        }
+        for (int q = 0; q < 4; q++) {
+            if (rows[q] == nullptr)
+                continue;
+            finishAVX512(k, acc[q][0], tile * 4 + q, in, inStride, rows[q], t, m0);
+            if (m1 != 0)
+                finishAVX512(k, acc[q][1], tile * 4 + q, in, inStride, rows[q], t + 16, m1);
+        }
+    }
+    return numFrames;
+}
+
+// four runs of taps per channel in flight, the frames past a multiple of 32 masked
+__attribute__((target("avx2,fma")))
+static void depthwiseAVX2(const Conv1dKernel& k, const float* in, int inStride, float* mid, int numFrames) {
+    const int K = k.kernelWidth, D = k.dilation;
+    const float* w = k.packedWeights.data() + k.depthwiseOffset;
+
+    for (int c = 0; c < k.inChannels; c++, w += K) {
+        const float* x = in + c * inStride;
+        float* y = mid + c * Conv1dKernel::separableFrames;
+        int t = 0;
+        for (; t + 32 <= numFrames; t += 32) {
+            __m256 acc[4] = {_mm256_setzero_ps(), _mm256_setzero_ps(), _mm256_setzero_ps(), _mm256_setzero_ps()};
+            for (int j = 0; j < K; j++) {
+                __m256 wj = _mm256_broadcast_ss(w + j);
+                for (int q = 0; q < 4; q++)
+                    acc[q] = _mm256_fmadd_ps(wj, _mm256_loadu_ps(x + j * D + t + 8 * q), acc[q]);
+            }
+            for (int q = 0; q < 4; q++)
+                _mm256_storeu_ps(y + t + 8 * q, acc[q]);
+        }
+        for (; t < numFrames; t += 8) {
+            const __m256i m = _mm256_cmpgt_epi32(_mm256_set1_epi32(numFrames - t), _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7));
+            __m256 acc = _mm256_setzero_ps();
+            for (int j = 0; j < K; j++)
+                acc = _mm256_fmadd_ps(_mm256_broadcast_ss(w + j), _mm256_maskload_ps(x + j * D + t, m), acc);
+            _mm256_storeu_ps(y + t, acc);
+        }
+    }
+}
+
+// the mid rows are padded to whole vectors, so only the stores are masked
+__attribute__((target("avx2,fma")))
+static void mixTileAVX2(const Conv1dKernel& k, const float* mid, const float* in, int inStride,
+                        float* const* rows, int tile, int numFrames) {
+    const int C = k.inChannels, S = Conv1dKernel::separableFrames;
+    const float* w = k.packedWeights.data() + tile * C * 4;
+    const float* b = k.packedBias.data() + tile * 4;
+
+    for (int t = 0; t < numFrames; t += 16) {
+        __m256 acc[4][2];
+        for (int q = 0; q < 4; q++)
+            acc[q][0] = acc[q][1] = _mm256_broadcast_ss(b + q);
+
+        for (int c = 0; c < C; c++) {
+            __m256 x0 = _mm256_loadu_ps(mid + c * S + t);
+            __m256 x1 = _mm256_loadu_ps(mid + c * S + t + 8);
+            for (int q = 0; q < 4; q++) {
+                __m256 wq = _mm256_broadcast_ss(w + c * 4 + q);
+                acc[q][0] = _mm256_fmadd_ps(wq, x0, acc[q][0]);
+                acc[q][1] = _mm256_fmadd_ps(wq, x1, acc[q][1]);
+            }
+        }
+        for (int q = 0; q < 4; q++) {
+            if (rows[q] == nullptr)
+                continue;
+            finishAVX2(k, acc[q][0], tile * 4 + q, in, inStride, rows[q], t, std::min(8, numFrames - t));
+            if (numFrames - t > 8)
+                finishAVX2(k, acc[q][1], tile * 4 + q, in, inStride, rows[q], t + 8, std::min(8, numFrames - t - 8));
+        }
+    }
+}
+
+__attribute__((target("avx2,fma")))
+static void mixTileSparseAVX2(const Conv1dKernel& k, const float* mid, const float* in, int inStride,
+                              float* const* rows, int tile, int numFrames) {
+    const int first = k.sparseStart[tile], last = k.sparseStart[tile + 1], S = Conv1dKernel::separableFrames;
+    const int32_t* index = k.sparseIndex.data();
+    const float* w = k.sparseWeights.data();
+    const float* b = k.packedBias.data() + tile * 4;
+
+    for (int t = 0; t < numFrames; t += 16) {
+        __m256 acc[4][2];
+        for (int q = 0; q < 4; q++)
+            acc[q][0] = acc[q][1] = _mm256_broadcast_ss(b + q);
+
+        for (int e = first; e < last; e++) {
+            __m256 x0 = _mm256_loadu_ps(mid + index[2 * e] * S + t);
+            __m256 x1 = _mm256_loadu_ps(mid + index[2 * e] * S + t + 8);
+            for (int q = 0; q < 4; q++) {
+                __m256 wq = _mm256_broadcast_ss(w + e * 4 + q);
+                acc[q][0] = _mm256_fmadd_ps(wq, x0, acc[q][0]);
+                acc[q][1] = _mm256_fmadd_ps(wq, x1, acc[q][1]);
+            }
+        }
+        for (int q = 0; q < 4; q++) {
+            if (rows[q] == nullptr)
+                continue;
+            finishAVX2(k, acc[q][0], tile * 4 + q, in, inStride, rows[q], t, std::min(8, numFrames - t));
+            if (numFrames - t > 8)
+                finishAVX2(k, acc[q][1], tile * 4 + q, in, inStride, rows[q], t + 8, std::min(8, numFrames - t - 8));
+        }
+    }
+}
+
+__attribute__((target("avx512f")))
+static void depthwiseAVX512(const Conv1dKernel& k, const float* in, int inStride, float* mid, int numFrames) {
+    const int K = k.kernelWidth, D = k.dilation;
+    const float* w = k.packedWeights.data() + k.depthwiseOffset;
+
+    for (int c = 0; c < k.inChannels; c++, w += K) {
+        const float* x = in + c * inStride;
+        float* y = mid + c * Conv1dKernel::separableFrames;
+        int t = 0;
+        for (; t + 64 <= numFrames; t += 64) {
+            __m512 acc[4] = {_mm512_setzero_ps(), _mm512_setzero_ps(), _mm512_setzero_ps(), _mm512_setzero_ps()};
+            for (int j = 0; j < K; j++) {
+                __m512 wj = _mm512_set1_ps(w[j]);
+                for (int q = 0; q < 4; q++)
+                    acc[q] = _mm512_fmadd_ps(wj, _mm512_loadu_ps(x + j * D + t + 16 * q), acc[q]);
+            }
+            for (int q = 0; q < 4; q++)
+                _mm512_storeu_ps(y + t + 16 * q, acc[q]);
+        }
+        for (; t < numFrames; t += 16) {
+            const __mmask16 m = frameMask(numFrames - t);
+            __m512 acc = _mm512_setzero_ps();
+            for (int j = 0; j < K; j++)
+                acc = _mm512_fmadd_ps(_mm512_set1_ps(w[j]), _mm512_maskz_loadu_ps(m, x + j * D + t), acc);
+            _mm512_storeu_ps(y + t, acc);
+        }
+    }
+}
+
+__attribute__((target("avx512f")))
+static void mixTileAVX512(const Conv1dKernel& k, const float* mid, const float* in, int inStride,
+                          float* const* rows, int tile, int numFrames) {
+    const int C = k.inChannels, S = Conv1dKernel::separableFrames;
+    const float* w = k.packedWeights.data() + tile * C * 4;
+
+    for (int t = 0; t < numFrames; t += 32) {
+        const __mmask16 m0 = frameMask(numFrames - t), m1 = frameMask(numFrames - t - 16);
+        __m512 acc[4][2];
+        for (int q = 0; q < 4; q++)
+            acc[q][0] = acc[q][1] = _mm512_set1_ps(k.packedBias[tile * 4 + q]);
+
+        for (int c = 0; c < C; c++) {
+            __m512 x0 = _mm512_loadu_ps(mid + c * S + t);
+            __m512 x1 = _mm512_loadu_ps(mid + c * S + t + 16);
+            for (int q = 0; q < 4; q++) {
+                __m512 wq = _mm512_set1_ps(w[c * 4 + q]);
+                acc[q][0] = _mm512_fmadd_ps(wq, x0, acc[q][0]);
+                acc[q][1] = _mm512_fmadd_ps(wq, x1, acc[q][1]);
+            }
+        }
+        for (int q = 0; q < 4; q++) {
+            if (rows[q] == nullptr)
+                continue;
+            finishAVX512(k, acc[q][0], tile * 4 + q, in, inStride, rows[q], t, m0);
+            if (m1 != 0)
+                finishAVX512(k, acc[q][1], tile * 4 + q, in, inStride, rows[q], t + 16, m1);
+        }
+    }
+}
+
+__attribute__((target("avx512f")))
+static void mixTileSparseAVX512(const Conv1dKernel& k, const float* mid, const float* in, int inStride,
+                                float* const* rows, int tile, int numFrames) {
+    const int first = k.sparseStart[tile], last = k.sparseStart[tile + 1], S = Conv1dKernel::separableFrames;
+    const int32_t* index = k.sparseIndex.data();
+    const float* w = k.sparseWeights.data();
+
+    for (int t = 0; t < numFrames; t += 32) {
+        const __mmask16 m0 = frameMask(numFrames - t), m1 = frameMask(numFrames - t - 16);
+        __m512 acc[4][2];
+        for (int q = 0; q < 4; q++)
+            acc[q][0] = acc[q][1] = _mm512_set1_ps(k.packedBias[tile * 4 + q]);
+
+        for (int e = first; e < last; e++) {
+            __m512 x0 = _mm512_loadu_ps(mid + index[2 * e] * S + t);
+            __m512 x1 = _mm512_loadu_ps(mid + index[2 * e] * S + t + 16);
+            for (int q = 0; q < 4; q++) {
+                __m512 wq = _mm512_set1_ps(w[e * 4 + q]);
+                acc[q][0] = _mm512_fmadd_ps(wq, x0, acc[q][0]);
+                acc[q][1] = _mm512_fmadd_ps(wq, x1, acc[q][1]);
+            }
+        }
+        for (int q = 0; q < 4; q++) {
+            if (rows[q] == nullptr)
+                continue;
+            finishAVX512(k, acc[q][0], tile * 4 + q, in, inStride, rows[q], t, m0);
+            if (m1 != 0)
+                finishAVX512(k, acc[q][1], tile * 4 + q, in, inStride, rows[q], t + 16, m1);
+        }
+    }
+}
+
+//==============================================================================
+// Quantised loops. The input rows are converted once per call, Int8 packs the
+// rows of channels 2p and 2p+1 side by side as the int16 pairs vpmaddwd and
+// vpdpwssd multiply against the pairs in packedPairs, Float16 stores halves and
+// widens them on load. The converted rows are zero padded past the last frame,
+// so the loops can always load whole vectors and only mask what they store.
+
+// the largest magnitude in x, which sets the step of the int8 input
+__attribute__((target("avx2,fma")))
+static float largestMagnitude(const float* x, int n) {
+    const __m256 sign = _mm256_set1_ps(-0.0f);
+    __m256 m = _mm256_setzero_ps();
+    int t = 0;
+    for (; t + 8 <= n; t += 8)
+        m = _mm256_max_ps(m, _mm256_andnot_ps(sign, _mm256_loadu_ps(x + t)));
+    alignas(32) float lanes[8];
+    _mm256_store_ps(lanes, m);
+    float largest = *std::max_element(lanes, lanes + 8);
+    for (; t < n; t++)
+        largest = std::max(largest, std::abs(x[t]));
+    return largest;
+}
+
+// scale, round and clamp to the int8 range, channel x1 may be nullptr
+__attribute__((target("avx2,fma")))
+static void convertPairs(const float* x0, const float* x1, float scale, int numFrames, int32_t* q) {
+    const __m256 s = _mm256_set1_ps(scale);
+    const __m256i lo = _mm256_set1_epi32(-127), hi = _mm256_set1_epi32(127), low16 = _mm256_set1_epi32(0xFFFF);
+    int t = 0;
+    for (; t + 8 <= numFrames; t += 8) {
+        __m256i a = _mm256_cvtps_epi32(_mm256_mul_ps(_mm256_loadu_ps(x0 + t), s));
+        a = _mm256_min_epi32(_mm256_max_epi32(a, lo), hi);
+        __m256i b = _mm256_setzero_si256();
+        if (x1 != nullptr) {
+            b = _mm256_cvtps_epi32(_mm256_mul_ps(_mm256_loadu_ps(x1 + t), s));
+            b = _mm256_min_epi32(_mm256_max_epi32(b, lo), hi);
+        }
+        _mm256_storeu_si256((__m256i*) (q + t), _mm256_or_si256(_mm256_and_si256(a, low16), _mm256_slli_epi32(b, 16)));
+    }
+    for (; t < numFrames; t++) {
+        int32_t a = std::min(std::max((int32_t) std::lrint(x0[t] * scale), -127), 127);
+        int32_t b = x1 != nullptr ? std::min(std::max((int32_t) std::lrint(x1[t] * scale), -127), 127) : 0;
+        q[t] = (int32_t) (((uint32_t) a & 0xFFFFu) | ((uint32_t) b << 16));
+    }
+}
+
+__attribute__((target("avx2,fma,f16c")))
+static void convertHalves(const float* x, int n, uint16_t* h) {
+    int t = 0;
+    for (; t + 8 <= n; t += 8)
+        _mm_storeu_si128((__m128i*) (h + t), _mm256_cvtps_ph(_mm256_loadu_ps(x + t), _MM_FROUND_TO_NEAREST_INT));
+    for (; t < n; t++)
+        h[t] = _cvtss_sh(x[t], _MM_FROUND_TO_NEAREST_INT);
+}
+
+__attribute__((target("avx2,fma,f16c")))
+static void expandHalves(const uint16_t* h, int n, float* x) {
+    int t = 0;
+    for (; t + 8 <= n; t += 8)
+        _mm256_storeu_ps(x + t, _mm256_cvtph_ps(_mm_loadu_si128((const __m128i*) (h + t))));
+    for (; t < n; t++)
+        x[t] = _cvtsh_ss(h[t]);
+}
+
+__attribute__((target("avx2,fma")))
+static void processTileInt8AVX2(const Conv1dKernel& k,
+                                const void* converted, int stride, float inputStep, float*,
+                                const float* in, int inStride,
+                                float* const* rows,
+                                int tile, int numFrames) {
+    const int K = k.kernelWidth, P = (k.inChannels + 1) / 2, D = k.dilation;
+    const int32_t* w = k.packedPairs.data() + tile * P * K * 4;
+
+    for (int t = 0; t < numFrames; t += 16) {
+        __m256i acc[4][2];
+        for (int q = 0; q < 4; q++)
+            acc[q][0] = acc[q][1] = _mm256_setzero_si256();
+
+        const int32_t* wp = w;
+        for (int p = 0; p < P; p++) {
+            const int32_t* x = (const int32_t*) converted + p * stride + t;
+            for (int j = 0; j < K; j++, wp += 4) {
+                __m256i x0 = _mm256_loadu_si256((const __m256i*) (x + j * D));
+                __m256i x1 = _mm256_loadu_si256((const __m256i*) (x + j * D + 8));
+                for (int q = 0; q < 4; q++) {
+                    __m256i wq = _mm256_set1_epi32(wp[q]);
+                    acc[q][0] = _mm256_add_epi32(acc[q][0], _mm256_madd_epi16(x0, wq));
+                    acc[q][1] = _mm256_add_epi32(acc[q][1], _mm256_madd_epi16(x1, wq));
+                }
+            }
+        }
+        for (int q = 0; q < 4; q++) {
+            if (rows[q] == nullptr)
+                continue;
+            const int o = tile * 4 + q;
+            const __m256 dq = _mm256_set1_ps(k.dequantise[o] * inputStep), b = _mm256_set1_ps(k.packedBias[o]);
+            finishAVX2(k, _mm256_fmadd_ps(_mm256_cvtepi32_ps(acc[q][0]), dq, b), o, in, inStride, rows[q], t, std::min(8, numFrames - t));
+            if (numFrames - t > 8)
+                finishAVX2(k, _mm256_fmadd_ps(_mm256_cvtepi32_ps(acc[q][1]), dq, b), o, in, inStride, rows[q], t + 8, std::min(8, numFrames - t - 8));
+        }
+    }
+}
+
+__attribute__((target("avx512f,avx512bw,avx512vnni")))
+static void processTileInt8AVX512(const Conv1dKernel& k,
+                                  const void* converted, int stride, float inputStep, float*,
+                                  const float* in, int inStride,
+                                  float* const* rows,
+                                  int tile, int numFrames) {
+    const int K = k.kernelWidth, P = (k.inChannels + 1) / 2, D = k.dilation;
+    const int32_t* w = k.packedPairs.data() + tile * P * K * 4;
+
+    for (int t = 0; t < numFrames; t += 32) {
+        __m512i acc[4][2];
+        for (int q = 0; q < 4; q++)
+            acc[q][0] = acc[q][1] = _mm512_setzero_si512();
+
+        const int32_t* wp = w;
+        for (int p = 0; p < P; p++) {
+            const int32_t* x = (const int32_t*) converted + p * stride + t;
+            for (int j = 0; j < K; j++, wp += 4) {
+                __m512i x0 = _mm512_loadu_si512(x + j * D);
+                __m512i x1 = _mm512_loadu_si512(x + j * D + 16);
+                for (int q = 0; q < 4; q++) {
+                    __m512i wq = _mm512_set1_epi32(wp[q]);
+                    acc[q][0] = _mm512_dpwssd_epi32(acc[q][0], x0, wq);
+                    acc[q][1] = _mm512_dpwssd_epi32(acc[q][1], x1, wq);
+                }
+            }
+        }
+        for (int q = 0; q < 4; q++) {
+            if (rows[q] == nullptr)
+                continue;
+            const int o = tile * 4 + q;
+            const __m512 dq = _mm512_set1_ps(k.dequantise[o] * inputStep), b = _mm512_set1_ps(k.packedBias[o]);
+            finishAVX512(k, _mm512_fmadd_ps(_mm512_cvtepi32_ps(acc[q][0]), dq, b), o, in, inStride, rows[q], t, frameMask(numFrames - t));
+            if (numFrames - t > 16)
+                finishAVX512(k, _mm512_fmadd_ps(_mm512_cvtepi32_ps(acc[q][1]), dq, b), o, in, inStride, rows[q], t + 16, frameMask(numFrames - t - 16));
+        }
+    }
+}
+
+__attribute__((target("avx2,fma,f16c")))
+static void processTileHalfAVX2(const Conv1dKernel& k,
+                                const void* converted, int stride, float, float* weights,
+                                const float* in, int inStride,
+                                float* const* rows,
+                                int tile, int numFrames) {
+    const int K = k.kernelWidth, C = k.inChannels, D = k.dilation;
+    const float* w = weights;
+    expandHalves(k.packedHalves.data() + tile * C * K * 4, C * K * 4, weights);
+
+    for (int t = 0; t < numFrames; t += 16) {
+        __m256 acc[4][2];
+        for (int q = 0; q < 4; q++)
+            acc[q][0] = acc[q][1] = _mm256_broadcast_ss(&k.packedBias[tile * 4 + q]);
+
+        const float* wp = w;
+        for (int c = 0; c < C; c++) {
+            const uint16_t* x = (const uint16_t*) converted + c * stride + t;
+            for (int j = 0; j < K; j++, wp += 4) {
+                __m256 x0 = _mm256_cvtph_ps(_mm_loadu_si128((const __m128i*) (x + j * D)));
+                __m256 x1 = _mm256_cvtph_ps(_mm_loadu_si128((const __m128i*) (x + j * D + 8)));
+                for (int q = 0; q < 4; q++) {
+                    __m256 wq = _mm256_broadcast_ss(wp + q);
+                    acc[q][0] = _mm256_fmadd_ps(wq, x0, acc[q][0]);
+                    acc[q][1] = _mm256_fmadd_ps(wq, x1, acc[q][1]);
+                }
+            }
+        }
+        for (int q = 0; q < 4; q++) {
+            if (rows[q] == nullptr)
+                continue;
+            finishAVX2(k, acc[q][0], tile * 4 + q, in, inStride, rows[q], t, std::min(8, numFrames - t));
+            if (numFrames - t > 8)
+                finishAVX2(k, acc[q][1], tile * 4 + q, in, inStride, rows[q], t + 8, std::min(8, numFrames - t - 8));
+        }
+    }
+}
+
+__attribute__((target("avx512f")))
+static void processTileHalfAVX512(const Conv1dKernel& k,
+                                  const void* converted, int stride, float, float* weights,
+                                  const float* in, int inStride,
+                                  float* const* rows,
+                                  int tile, int numFrames) {
+    const int K = k.kernelWidth, C = k.inChannels, D = k.dilation;
+    const float* w = weights;
+    expandHalves(k.packedHalves.data() + tile * C * K * 4, C * K * 4, weights);
+
+    for (int t = 0; t < numFrames; t += 32) {
+        __m512 acc[4][2];
+        for (int q = 0; q < 4; q++)
+            acc[q][0] = acc[q][1] = _mm512_set1_ps(k.packedBias[tile * 4 + q]);
+
+        const float* wp = w;
+        for (int c = 0; c < C; c++) {
+            const uint16_t* x = (const uint16_t*) converted + c * stride + t;
+            for (int j = 0; j < K; j++, wp += 4) {
+                __m512 x0 = _mm512_cvtph_ps(_mm256_loadu_si256((const __m256i*) (x + j * D)));
+                __m512 x1 = _mm512_cvtph_ps(_mm256_loadu_si256((const __m256i*) (x + j * D + 16)));
+                for (int q = 0; q < 4; q++) {
+                    __m512 wq = _mm512_set1_ps(wp[q]);
+                    acc[q][0] = _mm512_fmadd_ps(wq, x0, acc[q][0]);
+                    acc[q][1] = _mm512_fmadd_ps(wq, x1, acc[q][1]);
+                }
+            }
+        }
+        for (int q = 0; q < 4; q++) {
+            if (rows[q] == nullptr)
+                continue;
+            finishAVX512(k, acc[q][0], tile * 4 + q, in, inStride, rows[q], t, frameMask(numFrames - t));
+            if (numFrames - t > 16)
+                finishAVX512(k, acc[q][1], tile * 4 + q, in, inStride, rows[q], t + 16, frameMask(numFrames - t - 16));
+        }
+    }
+}
+
+static bool hasF16C() {
+    static const bool supported = [] {
+        __builtin_cpu_init();
+        return !!__builtin_cpu_supports("f16c");
+    }();
+    return supported;
+}
+
+static bool hasVNNI() {
+    static const bool supported = [] {
+        __builtin_cpu_init();
+        return __builtin_cpu_supports("avx512bw") && __builtin_cpu_supports("avx512vnni");
+    }();
+    return supported;
+}
+#endif
+
+//==============================================================================
+// shapes that get their own compiled tile loops, the kernel widths we ship
+// presets with crossed with the channel counts of the input and hidden layers
+struct SpecialisedTiles {
+    int kernelWidth, inChannels;
+    Conv1dKernel::ScalarTile scalar;
+    Conv1dKernel::SimdTile avx2, avx512;
+    Conv1dKernel::PairTile pairAVX512;
+};
+
+#if CONV1D_X86
+ #define CONV1D_TILES(K, C) {K, C, &processTileScalar<K, C>, &processTileAVX2<K, C>, &processTileAVX512<K, C>, \
+                             &processTilePairAVX512<K, C>}
+#else
+ #define CONV1D_TILES(K, C) {K, C, &processTileScalar<K, C>, nullptr, nullptr, nullptr}
+#endif
+
+static const SpecialisedTiles specialisedTiles[] = {
+    CONV1D_TILES(3, 1), CONV1D_TILES(3, 2), CONV1D_TILES(3, 4), CONV1D_TILES(3, 8), CONV1D_TILES(3, 16),
+    CONV1D_TILES(5, 1), CONV1D_TILES(5, 2), CONV1D_TILES(5, 4), CONV1D_TILES(5, 8), CONV1D_TILES(5, 16),
+    CONV1D_TILES(7, 1), CONV1D_TILES(7, 2), CONV1D_TILES(7, 4), CONV1D_TILES(7, 8), CONV1D_TILES(7, 16),
+};
+
+#undef CONV1D_TILES
+
+void Conv1dKernel::selectTiles() {
+    scalarTile = &processTileScalar<0, 0>;
+    simdTile = nullptr;
+    pairTile = nullptr;
+    quantisedTile = nullptr;
+    depthwiseStage = &depthwiseScalar;
+    mixTile = sparse ? &mixTileSparseScalar : &mixTileScalar;
+#if CONV1D_X86
+    if (tileWidth == 4) {
+        switch (isa) {
+            case AVX512:    simdTile = &processTileAVX512<0, 0>; pairTile = &processTilePairAVX512<0, 0>; break;
+            case AVX2:      simdTile = &processTileAVX2<0, 0>; break;
+            default:        break;
+        }
+    }
+    switch (isa) {
+        case AVX512:    depthwiseStage = &depthwiseAVX512; mixTile = sparse ? &mixTileSparseAVX512 : &mixTileAVX512; break;
+        case AVX2:      depthwiseStage = &depthwiseAVX2; mixTile = sparse ? &mixTileSparseAVX2 : &mixTileAVX2; break;
+        default:        break;
+    }
+    if (groups == 1 && !separable && isa != Scalar) {
+        if (precision == Int8)
+            quantisedTile = (isa == AVX512 && hasVNNI()) ? &processTileInt8AVX512 : &processTileInt8AVX2;
+        if (precision == Float16 && hasF16C())
+            quantisedTile = (isa == AVX512) ? &processTileHalfAVX512 : &processTileHalfAVX2;
+    }
+#endif
+    if (quantisedTile == nullptr)
+        precision = Float32;
+
+    // grouped layers keep the generic loops, separable ones have their own
+    if (groups != 1 || separable)
+        return;
+
+    if (sparse) {
+        scalarTile = &processTileSparseScalar;
+        pairTile = nullptr;
+#if CONV1D_X86
+        switch (isa) {
+            case AVX512:    simdTile = &processTileSparseAVX512; break;
+            case AVX2:      simdTile = &processTileSparseAVX2; break;
+            default:        break;
+        }
+#endif
+        return;
+    }
+
+    for (const auto& tiles : specialisedTiles) {
+        if (tiles.kernelWidth == kernelWidth && tiles.inChannels == inChannels) {
+            scalarTile = tiles.scalar;
+            switch (isa) {
+                case AVX512:    simdTile = tiles.avx512; pairTile = tiles.pairAVX512; break;
+                case AVX2:      simdTile = tiles.avx2; break;
+                default:        break;
+            }
+            return;
+        }
+    }
+}
+
+Conv1dKernel::Precision Conv1dKernel::setPrecision(Precision newPrecision) {
+    precision = newPrecision;
+    selectTiles();
+    if (precision != Float32)
+        quantiseWeights();
+    return precision;
+}
+
+// only resizes to the size it had before when called again, so requantising the
+// weights swapped in by a morph doesn't allocate
+void Conv1dKernel::quantiseWeights() {
+#if CONV1D_X86
+    if (precision == Float16) {
+        packedHalves.resize(packedWeights.size());
+        convertHalves(packedWeights.data(), (int) packedWeights.size(), packedHalves.data());
+    }
+    if (precision != Int8)
+        return;
+
+    const int tiles = (outChannels + 3) / 4, P = (inChannels + 1) / 2, K = kernelWidth;
+    packedPairs.assign(tiles * P * K * 4, 0);
+    dequantise.assign(tiles * 4, 0.0f);
+
+    for (int o = 0; o < outChannels; o++) {
+        int tile = o / 4, lane = o % 4;
+        const float* w = packedWeights.data() + tile * inChannels * K * 4 + lane;
+
+        float largest = 0.0f;
+        for (int i = 0; i < inChannels * K; i++)
+            largest = std::max(largest, std::abs(w[i * 4]));
+        float step = largest > 0.0f ? largest / 127.0f : 1.0f;
+        dequantise[o] = step;
+
+        for (int c = 0; c < inChannels; c++) {
+            for (int j = 0; j < K; j++) {
+                int32_t v = std::min(std::max((int32_t) std::lrint(w[(c * K + j) * 4] / step), -127), 127);
+                int32_t& pair = packedPairs[((tile * P + c / 2) * K + j) * 4 + lane];
+                pair = (int32_t) ((uint32_t) pair | (((uint32_t) v & 0xFFFFu) << (c % 2 == 0 ? 0 : 16)));
+            }
+        }
+    }
+#endif
+}
+
+int Conv1dKernel::prune(float threshold, float keep) {
+    if (tileWidth != 4)
+        return 0;
+
+    // the largest weight of each block, the mix of a separable layer has a single tap
+    const int K = separable ? 1 : kernelWidth;
+    const int tiles = outChannels / 4 + (outChannels % 4 != 0), blocks = tiles * inChannels * K;
+    std::vector<float> largest(blocks, 0.0f);
+    for (int b = 0; b < blocks; b++) {
+        for (int lane = 0; lane < 4; lane++)
+            largest[b] = std::max(largest[b], std::abs(packedWeights[b * 4 + lane]));
+    }
+
+    // the keep fraction moves the threshold up to the smallest block that stays
+    int numKept = (int) std::ceil(std::min(std::max(keep, 0.0f), 1.0f) * blocks);
+    if (numKept < blocks) {
+        std::vector<float> sorted = largest;
+        std::nth_element(sorted.begin(), sorted.begin() + (blocks - numKept), sorted.end());
+        threshold = std::max(threshold, numKept > 0 ? sorted[blocks - numKept] : std::numeric_limits<float>::infinity());
+    }
+
+    int zeroed = 0, zeroBlocks = 0;
+    prunedBlocks.assign(blocks, 0);
+    for (int b = 0; b < blocks; b++) {
+        if (largest[b] >= threshold && largest[b] > 0.0f)
+            continue;
+        prunedBlocks[b] = 1;
+        for (int lane = 0; lane < 4; lane++)
+            zeroed += packedWeights[b * 4 + lane] != 0.0f;
+        std::fill(packedWeights.begin() + b * 4, packedWeights.begin() + b * 4 + 4, 0.0f);
+        if (!unitWeights.empty())
+            std::fill(unitWeights.begin() + b * 4, unitWeights.begin() + b * 4 + 4, 0.0f);
+        zeroBlocks++;
+    }
+
+    // the index costs a little per block and the loops lose the fixed shape of
+    // the specialised ones, so it only pays once a third of the blocks are gone
+    dropSparse();
+    if (zeroBlocks * 3 >= blocks) {
+        sparseStart.assign(1, 0);
+        for (int tile = 0; tile < tiles; tile++) {
+            for (int c = 0; c < inChannels; c++) {
+                for (int j = 0; j < K; j++) {
+                    int b = (tile * inChannels + c) * K + j;
+                    if (largest[b] < threshold || largest[b] == 0.0f)
+                        continue;
+                    sparseIndex.push_back(c);
+                    sparseIndex.push_back(j * dilation);
+                    sparseWeights.insert(sparseWeights.end(), packedWeights.begin() + b * 4, packedWeights.begin() + b * 4 + 4);
+                }
+            }
+            sparseStart.push_back((int) sparseIndex.size() / 2);
+        }
+        sparse = true;
+        selectTiles();
+    }
+    if (hasMorphTarget())
+        measureMorph();
+    if (precision != Float32)
+        quantiseWeights();
+    return zeroed;
+}
+
+// back to the dense loops, for new weights
+void Conv1dKernel::dropSparse() {
+    if (!sparse)
+        return;
+    sparse = false;
+    sparseStart.clear();
+    sparseIndex.clear();
+    sparseWeights.clear();
+    selectTiles();
+}
+
+size_t Conv1dKernel::getScratchSize(int numFrames) const {
+    if (separable)
+        return inChannels * separableFrames * sizeof(float) + 64;
+    size_t stride = (size_t) getConvertedStride(numFrames);
+    switch (precision) {
+        case Int8:      return (inChannels + 1) / 2 * stride * sizeof(int32_t) + 64;
+        case Float16:   return inChannels * stride * sizeof(uint16_t) + inChannels * kernelWidth * 4 * sizeof(float) + 128;
+        default:        return 0;
+    }
+}
+
+static char* alignScratch(void* p) {
+    return (char*) p + (64 - (uintptr_t) p % 64) % 64;
+}
+
+// converts the numFrames + getContext() frames of every input row into scratch. Int8
+// spreads its steps over the largest input of the call, so whatever gains, FiLM or a
+// morph do to the input range it is never clipped, inputStep is set to the step. for
+// Float16 weights is set to the room after the rows for the weights of one tile
+const void* Conv1dKernel::convertInput(const float* in, int inStride, int numFrames, void* scratch,
+                                       float& inputStep, float*& weights) const {
+    const int frames = getContext() + numFrames, stride = getConvertedStride(numFrames);
+    char* base = alignScratch(scratch);
+    inputStep = 1.0f;
+    weights = nullptr;
+#if CONV1D_X86
+    if (precision == Int8) {
+        float largest = 0.0f;
+        for (int c = 0; c < inChannels; c++)
+            largest = std::max(largest, largestMagnitude(in + c * inStride, frames));
+        if (largest > 0.0f)
+            inputStep = largest / 127.0f;
+
+        int32_t* q = (int32_t*) base;
+        for (int p = 0; p < (inChannels + 1) / 2; p++) {
+            const float* x1 = (2 * p + 1 < inChannels) ? in + (2 * p + 1) * inStride : nullptr;
+            convertPairs(in + 2 * p * inStride, x1, 1.0f / inputStep, frames, q + p * stride);
+            std::fill(q + p * stride + frames, q + (p + 1) * stride, 0);
+        }
+    }
+    if (precision == Float16) {
+        uint16_t* h = (uint16_t*) base;
+        for (int c = 0; c < inChannels; c++) {
+            convertHalves(in + c * inStride, frames, h + c * stride);
+            std::fill(h + c * stride + frames, h + (c + 1) * stride, (uint16_t) 0);
+        }
+        weights = (float*) alignScratch(h + inChannels * stride);
+    }
+#else
+    (void) in; (void) inStride; (void) frames; (void) stride;
+#endif
+    return base;
+}
+
+void Conv1dKernel::processTile(const float* in, int inStride, float* const* rows, int tile, int numFrames) const {
+    int done = 0;
+    if (simdTile != nullptr)
+        done = simdTile(*this, in, inStride, rows, tile, numFrames);
+    if (done < numFrames)
+        scalarTile(*this, in, inStride, rows, tile, done, numFrames);
+}
+
+void Conv1dKernel::process(const float* in, int inStride, float* out, int outStride, int numFrames, void* scratch) const {
+    processRows(in, inStride, nullptr, out, outStride, numFrames, scratch);
+}
+
+void Conv1dKernel::process(const float* in, int inStride, float* const* out, int numFrames, void* scratch) const {
+    processRows(in, inStride, out, nullptr, 0, numFrames, scratch);
+}
+
+// output o goes to out[o], or to outBase + o * outStride when out is nullptr
+void Conv1dKernel::processRows(const float* in, int inStride, float* const* out, float* outBase, int outStride,
+                               int numFrames, void* scratch) const {
+    int tiles = (outChannels + tileWidth - 1) / tileWidth;
+
+    const void* converted = nullptr;
+    float inputStep = 1.0f;
+    float* weights = nullptr;
+    std::vector<char> ownScratch;
+    if (scratch == nullptr && (precision != Float32 || separable)) {
+        ownScratch.resize(getScratchSize(numFrames));
+        scratch = ownScratch.data();
+    }
+    if (separable) {
+        processSeparable(in, inStride, out, outBase, outStride, numFrames, (float*) alignScratch(scratch));
+        return;
+    }
+    if (precision != Float32)
+        converted = convertInput(in, inStride, numFrames, scratch, inputStep, weights);
+
+    for (int tile = 0; tile < tiles; tile++) {
+        float* rows[4] = {nullptr, nullptr, nullptr, nullptr};
+        for (int lane = 0; lane < tileWidth && tile * tileWidth + lane < outChannels; lane++) {
+            int o = tile * tileWidth + lane;
+            rows[lane] = out != nullptr ? out[o] : outBase + o * outStride;
+        }
+        if (converted != nullptr)
+            quantisedTile(*this, converted, getConvertedStride(numFrames), inputStep, weights, in, inStride, rows, tile, numFrames);
+        else
+            processTile(in, inStride, rows, tile, numFrames);
+    }
+}
+
+// each tile of outputs for every lane before the next tile, two lanes at a time where there is a pair
+// loop and the rest like processTile
+void Conv1dKernel::processLanes(int numLanes, const float* const* in, int inStride, float* const* const* out,
+                                int numFrames, void* const* scratch) const {
+    if (separable || precision != Float32) {
+        for (int lane = 0; lane < numLanes; lane++)
+            processRows(in[lane], inStride, out[lane], nullptr, 0, numFrames, scratch != nullptr ? scratch[lane] : nullptr);
+        return;
+    }
+
+    int tiles = (outChannels + tileWidth - 1) / tileWidth;
+    for (int tile = 0; tile < tiles; tile++) {
+        float* rows[2][4] = {{nullptr, nullptr, nullptr, nullptr}, {nullptr, nullptr, nullptr, nullptr}};
+        for (int lane = 0; lane < numLanes; ) {
+            int pair = (pairTile != nullptr && lane + 1 < numLanes) ? 2 : 1;
+            for (int l = 0; l < pair; l++) {
+                for (int q = 0; q < tileWidth && tile * tileWidth + q < outChannels; q++)
+                    rows[l][q] = out[lane + l][tile * tileWidth + q];
+            }
+
+            if (pair == 1) {
+                processTile(in[lane], inStride, rows[0], tile, numFrames);
+            } else {
+                const float* pairIn[2] = {in[lane], in[lane + 1]};
+                float* const* pairRows[2] = {rows[0], rows[1]};
+                int done = pairTile(*this, pairIn, inStride, pairRows, tile, numFrames);
+                for (int l = 0; l < 2 && done < numFrames; l++)
+                    scalarTile(*this, in[lane + l], inStride, rows[l], tile, done, numFrames);
+            }
+            lane += pair;
+        }
+    }
+}
+
+// the taps of a pass over the frames into mid, then every tile of outputs mixes them
+void Conv1dKernel::processSeparable(const float* in, int inStride, float* const* out, float* outBase, int outStride,
+                                    int numFrames, float* mid) const {
+    int tiles = (outChannels + 3) / 4;
+    for (int t = 0; t < numFrames; t += separableFrames) {
+        int n = std::min(separableFrames, numFrames - t);
+        depthwiseStage(*this, in + t, inStride, mid, n);
+        for (int tile = 0; tile < tiles; tile++) {
+            float* rows[4] = {nullptr, nullptr, nullptr, nullptr};
+            for (int lane = 0; lane < 4 && tile * 4 + lane < outChannels; lane++) {
+                int o = tile * 4 + lane;
+                float* row = out != nullptr ? out[o] : outBase + o * outStride;
+                rows[lane] = row != nullptr ? row + t : nullptr;
+            }
+            mixTile(*this, mid, in + t, inStride, rows, tile, n);
+        }
+    }
+}
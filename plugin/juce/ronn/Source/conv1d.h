@@ -0,0 +1,197 @@
+#ifndef CONV1D_H
+#define CONV1D_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "activations.h"
+
+// Direct (no im2col) dilated 1d convolution for the small channel counts
+// ronn runs with. Weights are packed once into tiles of output channels so
+// the inner loop broadcasts consecutive weights while contiguous input
+// frames stream through the SIMD lanes.
+struct Conv1dKernel {
+
+    public:
+
+        enum ISA {Scalar, AVX2, AVX512};
+        enum Precision {Float32, Float16, Int8};
+
+        // loops computing one tile of output channels, SimdTile returns how many
+        // frames it managed and ScalarTile finishes frames [t0, t1)
+        typedef int  (*SimdTile)  (const Conv1dKernel&, const float* in, int inStride, float* const* rows, int tile, int numFrames);
+        typedef void (*ScalarTile)(const Conv1dKernel&, const float* in, int inStride, float* const* rows, int tile, int t0, int t1);
+
+        // a tile of two lanes at once, in[lane] and rows[lane] like a SimdTile, returns how many frames it managed
+        typedef int  (*PairTile)  (const Conv1dKernel&, const float* const* in, int inStride, float* const* const* rows, int tile, int numFrames);
+
+        // the quantised loops read the input converted into `converted` rows convertedStride
+        // apart, in steps of inputStep for Int8, and widen the weights of their tile into
+        // `weights` where the format needs that. the float input is only read for the
+        // residual. they do all numFrames
+        typedef void (*QuantisedTile)(const Conv1dKernel&, const void* converted, int convertedStride, float inputStep, float* weights,
+                                      const float* in, int inStride, float* const* rows, int tile, int numFrames);
+
+        // the two stages of a separable layer, the depthwise taps of numFrames <= separableFrames
+        // frames of every input into mid rows separableFrames apart, then the mix of one tile
+        // of outputs from them, reading the input only for the residual
+        typedef void (*DepthwiseStage)(const Conv1dKernel&, const float* in, int inStride, float* mid, int numFrames);
+        typedef void (*MixTile)(const Conv1dKernel&, const float* mid, const float* in, int inStride,
+                                float* const* rows, int tile, int numFrames);
+        static const int separableFrames = 64;
+
+        Conv1dKernel();
+
+        void setup(int nInputs,
+                   int nOutputs,
+                   int kWidth,
+                   int dilation,
+                   int groups,
+                   bool useBias,
+                   bool separable = false);
+
+        // weight in torch layout {outChannels, inChannels/groups, kWidth},
+        // bias may be nullptr when the layer has none. a separable layer (depthwise
+        // taps followed by a 1x1 mix, groups is ignored) takes the taps {inChannels, 1, kWidth}
+        // as weight and the mix {outChannels, inChannels, 1}, the bias goes after the mix
+        void packWeights(const float* weight, const float* bias, const float* mix = nullptr);
+
+        // activation applied to the outputs before they are stored, Linear
+        // for the last layer of the model
+        void setActivation(activations::Type act) {activation = act;};
+
+        // per output channel y = scale * conv(x) + shift ahead of the activation,
+        // used for FiLM conditioning. Only writes preallocated storage, so it can
+        // be called between blocks on the audio thread, nullptr turns it off
+        void setOutputScale(const float* scale, const float* shift);
+
+        // residual connection, adds the input frame at the centre of each output's window
+        // after the activation, like center_crop in dev/ronn. needs as many inputs as
+        // outputs, or a single input which is added to every output
+        void setResidual(bool enabled);
+        bool canAddResidual() const {return inChannels == outChannels || inChannels == 1;};
+
+        // gains folded into the weights, y = outputGain * layer(inputGain * x), which needs
+        // a linear activation unless outputGain is 1. the weights at unit gain are copied on
+        // the first call, so later calls don't allocate. fails, leaving the gains at 1, when
+        // a residual connection would make that inexact
+        bool setGains(float newInputGain, float newOutputGain);
+
+        // weight morphing, the packed weights and biases become a * this kernel's +
+        // b * the target's, written a slice at a time into a second buffer that
+        // replaces them on swapMorph(). only setMorphTarget allocates, and it fails
+        // unless the target has the same shape
+        bool setMorphTarget(const Conv1dKernel& target);
+        void clearMorph();
+        bool hasMorphTarget() const {return !morphEnds[0].empty();};
+        int getMorphSize() const {return (int) morphEnds[0].size();};
+        void morph(float a, float b, int start, int numWeights);
+        void swapMorph();
+
+        // quantised storage for wide layers, where streaming the input rows past every tile
+        // of outputs costs more than the arithmetic. the input is converted on the way in,
+        // which halves that traffic. Int8 multiplies int8 weights (symmetric per output channel)
+        // with int8 inputs (symmetric over the largest input of each call) and accumulates in
+        // int32, Float16 keeps weights and inputs as halves and computes in fp32. needs the
+        // SIMD loops and a dense layer, otherwise it stays Float32, which is returned
+        Precision setPrecision(Precision newPrecision);
+        Precision getPrecision() const {return precision;};
+
+        // magnitude pruning in blocks of the 4 weights a tap of one input channel has in a
+        // tile of outputs, which the SIMD loops compute together. blocks whose largest weight
+        // is below threshold are zeroed, and of the rest at most the largest keep fraction stay.
+        // with enough blocks gone the loops only visit the remaining ones. the pruned blocks stay
+        // zero through a morph, new weights bring the dense loops back. separable layers prune
+        // their mix and keep the depthwise taps. returns the number of weights zeroed, 0 for
+        // grouped layers
+        int prune(float threshold, float keep = 1.0f);
+        bool isSparse() const {return sparse;};
+
+        // bytes of scratch for the converted input of numFrames new frames, or the depthwise
+        // output of a separable layer, 0 for a Float32 dense layer
+        size_t getScratchSize(int numFrames) const;
+
+        // in:  inChannels rows holding numFrames + getContext() frames each, inStride apart
+        // out: outChannels rows of numFrames frames each, outStride apart
+        // quantised and separable kernels use getScratchSize() bytes of scratch, or allocate them when it is nullptr
+        void process(const float* in, int inStride, float* out, int outStride, int numFrames, void* scratch = nullptr) const;
+
+        // same, writing each output channel to its own row, nullptr rows are skipped
+        void process(const float* in, int inStride, float* const* out, int numFrames, void* scratch = nullptr) const;
+
+        // numLanes independent inputs through the same weights, in[lane] and out[lane] like
+        // process() and scratch[lane] for each of them (scratch itself may be nullptr). a tile of
+        // outputs is computed for every lane before the next, the AVX512 float loops take two
+        // lanes at once so each weight they load serves both. quantised and separable kernels
+        // run the lanes one after the other
+        void processLanes(int numLanes, const float* const* in, int inStride, float* const* const* out,
+                          int numFrames, void* const* scratch = nullptr) const;
+
+        int getContext() const {return (kernelWidth-1) * dilation;};
+        int getInputs() const {return inChannels;};
+        int getOutputs() const {return outChannels;};
+
+        void setISA(ISA newISA);
+        ISA getISA() const {return isa;};
+        static ISA detectISA();
+        static const char* getISAName(ISA isa);
+
+        // packed layout, read by the ISA specific loops
+        int inChannels, outChannels, kernelWidth, dilation, groups;
+        bool bias;
+        activations::Type activation;
+        int tileWidth;                      // output channels computed together
+        std::vector<float> packedWeights;   // {tiles, inChannels/groups, kWidth, tileWidth}
+        std::vector<float> packedBias;      // {tiles * tileWidth}, zero padded
+        bool scaled;
+        std::vector<float> packedScale, packedShift;   // {tiles * tileWidth}
+        bool residual;
+        int residualOffset;                 // of the skip input frame in the input rows
+        double morphDot, morphNorms[2];     // of the two morph ends, for spherical interpolation
+        float inputGain, outputGain;        // folded into packedWeights, packedBias and packedShift
+        Precision precision;
+        std::vector<int32_t> packedPairs;   // Int8, {tiles, (inChannels+1)/2, kWidth, tileWidth} pairs of int16 weights
+        std::vector<float> dequantise;      // Int8, {tiles * tileWidth} weight step
+        std::vector<uint16_t> packedHalves; // Float16, packedWeights as halves
+        bool sparse;
+        std::vector<int32_t> sparseStart;   // {tiles + 1}, first block of each tile
+        std::vector<int32_t> sparseIndex;   // {blocks, 2} input row and frame offset (tap * dilation)
+        std::vector<float> sparseWeights;   // {blocks, tileWidth}
+        bool separable;
+        int depthwiseOffset;                // separable, of the taps {inChannels, kWidth} after the mix in packedWeights
+
+    private:
+        void processTile(const float* in, int inStride, float* const* rows, int tile, int numFrames) const;
+        void processRows(const float* in, int inStride, float* const* out, float* outBase, int outStride,
+                         int numFrames, void* scratch) const;
+        void processSeparable(const float* in, int inStride, float* const* out, float* outBase, int outStride,
+                              int numFrames, float* mid) const;
+        void selectTiles();
+        void quantiseWeights();
+        void dropSparse();
+        void copySparse();
+        void measureMorph();
+        void applyGains();
+        void refreshGains();
+        const std::vector<float>& getUnitWeights() const {return unitWeights.empty() ? packedWeights : unitWeights;};
+        const std::vector<float>& getUnitBias() const {return unitWeights.empty() ? packedBias : unitBias;};
+        const void* convertInput(const float* in, int inStride, int numFrames, void* scratch,
+                                 float& inputStep, float*& weights) const;
+        int getConvertedStride(int numFrames) const {return getContext() + numFrames + 32;};
+
+        ISA isa;
+        SimdTile simdTile;          // specialised for the layer shape when one was compiled
+        ScalarTile scalarTile;
+        PairTile pairTile;
+        QuantisedTile quantisedTile;
+        DepthwiseStage depthwiseStage;
+        MixTile mixTile;
+
+        std::vector<float> morphEnds[2];                // {packed weights, packed bias} of both ends
+        std::vector<float> morphWeights, morphBias;     // the interpolation being written
+        std::vector<float> unitWeights, unitBias, unitShift;    // at unit gain, once there are gains
+        std::vector<uint8_t> prunedBlocks;                      // {blocks}, 1 where prune zeroed the block
+};
+
+#endif
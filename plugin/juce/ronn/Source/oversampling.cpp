@@ -0,0 +1,196 @@
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#include "oversampling.h"
+#include "activations.h"
+
+// half-band taps per side for each 2x stage, the first one does the real work
+static const int stageHalfLengths[] = {16, 5, 4};
+
+// zeroth order modified Bessel function of the first kind, for the Kaiser window
+static double besselI0(double x) {
+    double sum = 1.0, term = 1.0;
+    for (int k = 1; k < 32; k++) {
+        term *= (x / (2.0 * k)) * (x / (2.0 * k));
+        sum += term;
+    }
+    return sum;
+}
+
+// Kaiser windowed sinc half-band filter, 2K non-zero taps at odd offsets from the centre,
+// normalised so that together with the centre tap of 1/2 the dc gain is one
+static std::vector<float> designHalfBand(int half, double transition) {
+    int delay = 2 * half - 1;
+    double attenuation = 2.285 * 2.0 * delay * 2.0 * M_PI * transition + 8.0;
+    double beta = attenuation > 50.0 ? 0.1102 * (attenuation - 8.7)
+                                     : 0.5842 * std::pow(attenuation - 21.0, 0.4) + 0.07886 * (attenuation - 21.0);
+
+    std::vector<double> taps(2 * half);
+    double sum = 0.0;
+    for (int j = 0; j < 2 * half; j++) {
+        double k = 2 * j - delay;
+        double r = k / (delay + 1);
+        double window = besselI0(beta * std::sqrt(1.0 - r * r)) / besselI0(beta);
+        taps[j] = std::sin(M_PI * k / 2.0) / (M_PI * k) * window;
+        sum += taps[j];
+    }
+
+    std::vector<float> result(2 * half);
+    for (int j = 0; j < 2 * half; j++)
+        result[j] = (float) (taps[j] * 0.5 / sum);
+    return result;
+}
+
+// y[t] += sum over j of taps[j] * x[t - j], eight frames at a time held in registers over all taps
+static inline void filter(const float* x, const float* taps, int numTaps, float* y, int n) {
+    int t = 0;
+#if defined(__GNUC__) || defined(__clang__)
+    using activations::vf4;
+    for (; t + 8 <= n; t += 8) {
+        vf4 a0, a1, b0, b1;
+        std::memcpy(&a0, y + t, sizeof(a0));
+        std::memcpy(&a1, y + t + 4, sizeof(a1));
+        for (int j = 0; j < numTaps; j++) {
+            std::memcpy(&b0, x + t - j, sizeof(b0));
+            std::memcpy(&b1, x + t + 4 - j, sizeof(b1));
+            a0 += taps[j] * b0;
+            a1 += taps[j] * b1;
+        }
+        std::memcpy(y + t, &a0, sizeof(a0));
+        std::memcpy(y + t + 4, &a1, sizeof(a1));
+    }
+#endif
+    for (; t < n; t++) {
+        float acc = y[t];
+        for (int j = 0; j < numTaps; j++)
+            acc += taps[j] * x[t - j];
+        y[t] = acc;
+    }
+}
+
+//==============================================================================
+Oversampler::Oversampler(int f, int upChannels, int downChannels, int maxBlockSize)
+    : factor(1), maxBlock(std::max(maxBlockSize, 1)) {
+
+    int numStages = 0;
+    while (factor < f && numStages < (int) (sizeof(stageHalfLengths) / sizeof(int))) {
+        Stage stage;
+        stage.half = stageHalfLengths[numStages];
+        stage.maxFrames = maxBlock * factor;
+
+        // passband up to 0.4 of the base rate, images start at the stage's lower rate minus that
+        double passband = 0.4 / (2.0 * factor);
+        stage.taps = designHalfBand(stage.half, 0.5 - 2.0 * passband);
+        for (auto tap : stage.taps)
+            stage.upTaps.push_back(2.0f * tap);     // makes up for the zeros stuffed in between
+
+        stages.push_back(stage);
+        factor *= 2;
+        numStages++;
+    }
+
+    for (int c = 0; c < upChannels; c++)
+        for (auto& stage : stages)
+            upHistory.emplace_back(2 * stage.half - 1 + stage.maxFrames, 0.0f);
+    for (int c = 0; c < downChannels; c++) {
+        for (auto& stage : stages) {
+            downEven.emplace_back(2 * stage.half - 1 + stage.maxFrames, 0.0f);
+            downOdd.emplace_back(2 * stage.half - 1 + stage.maxFrames, 0.0f);
+        }
+    }
+    scratch[0].resize(maxBlock * factor);
+    scratch[1].resize(maxBlock * factor);
+    phase.resize(maxBlock * factor);
+}
+
+void Oversampler::reset() {
+    for (auto& row : upHistory)
+        std::fill(row.begin(), row.end(), 0.0f);
+    for (auto& row : downEven)
+        std::fill(row.begin(), row.end(), 0.0f);
+    for (auto& row : downOdd)
+        std::fill(row.begin(), row.end(), 0.0f);
+}
+
+// each stage delays by 2K - 1 frames of its higher rate in each direction
+double Oversampler::getLatency() const {
+    double latency = 0.0;
+    for (int s = 0; s < (int) stages.size(); s++)
+        latency += (2 * stages[s].half - 1) / (double) (1 << s);
+    return latency;
+}
+
+int Oversampler::getLatencySamples() const {
+    return (int) std::lround(getLatency());
+}
+
+//==============================================================================
+void Oversampler::upsample(int channel, const float* input, float* output, int numSamples) {
+    int numStages = (int) stages.size();
+    if (numStages == 0) {
+        std::memcpy(output, input, numSamples * sizeof(float));
+        return;
+    }
+
+    const float* x = input;
+    for (int s = 0, n = numSamples; s < numStages; s++, n *= 2) {
+        float* y = (s + 1 == numStages) ? output : scratch[s % 2].data();
+        float* history = upHistory[channel * numStages + s].data();
+        std::memcpy(history + 2 * stages[s].half - 1, x, n * sizeof(float));
+        upsampleStage(s, history, y, n);
+        x = y;
+    }
+}
+
+void Oversampler::downsample(int channel, const float* input, float* output, int numSamples) {
+    int numStages = (int) stages.size();
+    if (numStages == 0) {
+        std::memcpy(output, input, numSamples * sizeof(float));
+        return;
+    }
+
+    const float* x = input;
+    for (int s = numStages - 1, n = numSamples << (numStages - 1); s >= 0; s--, n /= 2) {
+        float* y = (s == 0) ? output : scratch[s % 2].data();
+        downsampleStage(s, downEven[channel * numStages + s].data(), downOdd[channel * numStages + s].data(), x, y, n);
+        x = y;
+    }
+}
+
+// n new frames after the history, 2n out: the even phase runs the taps,
+// the odd phase is the input delayed to the centre tap
+void Oversampler::upsampleStage(int s, float* history, float* output, int n) {
+    const Stage& stage = stages[s];
+    int past = 2 * stage.half - 1;
+    const float* x = history + past;
+
+    std::fill(phase.begin(), phase.begin() + n, 0.0f);
+    filter(x, stage.upTaps.data(), 2 * stage.half, phase.data(), n);
+
+    for (int t = 0; t < n; t++) {
+        output[2 * t] = phase[t];
+        output[2 * t + 1] = x[t - stage.half + 1];
+    }
+    std::memmove(history, history + n, past * sizeof(float));
+}
+
+// 2n frames in, n out: the taps run on the even input frames, the odd ones
+// only meet the centre tap
+void Oversampler::downsampleStage(int s, float* even, float* odd, const float* input, float* output, int n) {
+    const Stage& stage = stages[s];
+    int past = 2 * stage.half - 1;
+    for (int t = 0; t < n; t++) {
+        even[past + t] = input[2 * t];
+        odd[past + t] = input[2 * t + 1];
+    }
+
+    const float* x = even + past;
+    const float* centre = odd + past - stage.half;
+    for (int t = 0; t < n; t++)
+        output[t] = 0.5f * centre[t];
+    filter(x, stage.taps.data(), 2 * stage.half, output, n);
+
+    std::memmove(even, even + n, past * sizeof(float));
+    std::memmove(odd, odd + n, past * sizeof(float));
+}
@@ -0,0 +1,55 @@
+#ifndef OVERSAMPLING_H
+#define OVERSAMPLING_H
+
+#include <vector>
+
+// 2x, 4x or 8x oversampling as a cascade of 2x half-band FIR stages in
+// polyphase form. A half-band filter has every other tap zero and a centre
+// tap of 1/2, so each stage only runs its 2K odd taps on one phase and the
+// other phase is a plain delay, at the lower of its two rates.
+//
+// The first stage has the steep transition (0.4 to 0.6 of the base rate),
+// the later ones only have to remove images far above the passband and get
+// away with a few taps. Up and down together delay the signal by
+// getLatency() frames of the base rate.
+//
+// Independent streams (channels) are filtered in each direction, all state
+// is allocated up front for blocks of up to maxBlock base rate frames.
+class Oversampler {
+
+    public:
+
+        Oversampler(int factor, int upChannels, int downChannels, int maxBlock);
+
+        // numSamples base rate frames in, numSamples * factor frames out
+        void upsample(int channel, const float* input, float* output, int numSamples);
+        // numSamples * factor frames in, numSamples base rate frames out
+        void downsample(int channel, const float* input, float* output, int numSamples);
+        void reset();
+
+        int getFactor() const {return factor;};
+        double getLatency() const;
+        int getLatencySamples() const;
+
+    private:
+        // one 2x stage, taps are the 2K non-zero odd taps, the up direction's are doubled
+        struct Stage {
+            int half;                               // K
+            std::vector<float> taps, upTaps;
+            int maxFrames;                          // at the lower rate
+        };
+
+        void upsampleStage(int s, float* history, float* output, int n);
+        void downsampleStage(int s, float* even, float* odd, const float* input, float* output, int n);
+
+        int factor, maxBlock;
+        std::vector<Stage> stages;
+
+        // rows of (2K - 1) past frames followed by the new ones, per channel and stage
+        std::vector<std::vector<float>> upHistory;      // [channel * stages + s]
+        std::vector<std::vector<float>> downEven;       // [channel * stages + s], even input frames
+        std::vector<std::vector<float>> downOdd;        // odd input frames
+        std::vector<float> scratch[2], phase;           // between the stages
+};
+
+#endif
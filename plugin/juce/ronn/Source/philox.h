@@ -0,0 +1,69 @@
+#ifndef PHILOX_H
+#define PHILOX_H
+
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+
+// Philox4x32-10 (Salmon et al., "Parallel random numbers: as easy as 1, 2, 3"),
+// a counter based generator: every block of 4 numbers is a function of the key
+// and its index only. A stream per tensor (seed, stream) can be filled in any
+// order, from any number of threads, with no generator state to carry around
+// or allocate, and the same seed always gives the same weights.
+struct Philox {
+
+    public:
+
+        Philox(uint64_t seed, uint32_t stream) :
+            key{(uint32_t) seed, (uint32_t) (seed >> 32)}, stream(stream) {};
+
+        // the 4 numbers of block index
+        void block(uint64_t index, uint32_t out[4]) const {
+            uint32_t c[4] = {(uint32_t) index, (uint32_t) (index >> 32), stream, 0};
+            uint32_t k[2] = {key[0], key[1]};
+            for (int round = 0; round < 10; round++) {
+                uint64_t p0 = (uint64_t) 0xD2511F53 * c[0];
+                uint64_t p1 = (uint64_t) 0xCD9E8D57 * c[2];
+                uint32_t next[4] = {(uint32_t) (p1 >> 32) ^ c[1] ^ k[0], (uint32_t) p1,
+                                    (uint32_t) (p0 >> 32) ^ c[3] ^ k[1], (uint32_t) p0};
+                for (int i = 0; i < 4; i++)
+                    c[i] = next[i];
+                k[0] += 0x9E3779B9;
+                k[1] += 0xBB67AE85;
+            }
+            for (int i = 0; i < 4; i++)
+                out[i] = c[i];
+        }
+
+        // x[i] uniform in [low, high)
+        void uniform(float* x, size_t n, float low, float high) const {
+            uint32_t r[4];
+            for (size_t i = 0; i < n; i++) {
+                if (i % 4 == 0)
+                    block(i / 4, r);
+                x[i] = low + (high - low) * toUnit(r[i % 4]);
+            }
+        }
+
+        // x[i] normal with mean and stddev, Box-Muller on pairs of the numbers
+        void normal(float* x, size_t n, float mean, float stddev) const {
+            uint32_t r[4];
+            for (size_t i = 0; i < n; i++) {
+                if (i % 4 == 0)
+                    block(i / 4, r);
+                size_t pair = i % 4 & ~(size_t) 1;
+                double radius = std::sqrt(-2.0 * std::log(1.0 - toUnit(r[pair])));
+                double angle = 6.283185307179586 * toUnit(r[pair + 1]);
+                x[i] = mean + stddev * (float) (radius * (i % 2 == 0 ? std::cos(angle) : std::sin(angle)));
+            }
+        }
+
+    private:
+        // [0, 1) in steps of 2^-24
+        static float toUnit(uint32_t r) {return (r >> 8) * (1.0f / 16777216.0f);};
+
+        uint32_t key[2];
+        uint32_t stream;
+};
+
+#endif
@@ -0,0 +1,288 @@
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <memory>
+
+#include "pipeline.h"
+#include "ronnlib.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+ #include <xmmintrin.h>
+#endif
+
+ModelPipeline::BlockQueue::BlockQueue(int capacity, int channels, int maxBlock) : slots(capacity) {
+    for (auto& block : slots) {
+        block.numSamples = 0;
+        block.sequence = 0;
+        block.data.assign(channels * maxBlock, 0.0f);
+    }
+}
+
+ModelPipeline::Block* ModelPipeline::BlockQueue::beginWrite() {
+    uint32_t t = tail.load(std::memory_order_relaxed);
+    if (t - head.load(std::memory_order_acquire) == slots.size())
+        return nullptr;
+    return &slots[t % slots.size()];
+}
+
+void ModelPipeline::BlockQueue::endWrite() {
+    tail.store(tail.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+}
+
+ModelPipeline::Block* ModelPipeline::BlockQueue::beginRead() {
+    uint32_t h = head.load(std::memory_order_relaxed);
+    if (h == tail.load(std::memory_order_acquire))
+        return nullptr;
+    return &slots[h % slots.size()];
+}
+
+void ModelPipeline::BlockQueue::endRead() {
+    head.store(head.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+}
+
+//==============================================================================
+ModelPipeline::ModelPipeline(Model& m, const std::vector<int>& starts)
+    : model(m), stageStarts(starts), lanes(m.getLanes()), maxBlock(m.getMaxBlockSize()) {
+
+    int stages = getNumStages();
+    inputs.resize(lanes, std::vector<float>(model.getInputs() * 2 * maxBlock, 0.0f));
+    pendingScales = model.film;
+    stageSync.reset(new StageSync[stages]);
+
+    // the queue into stage s carries the inputs of its first layer, the last one the model outputs,
+    // with room for every block in flight plus some slack for a late worker
+    for (int lane = 0; lane < lanes; lane++) {
+        for (int s = 0; s <= stages; s++) {
+            int channels = (s < stages) ? model.getLayerInputs(stageStarts[s]) : model.getOutputs();
+            queues.emplace_back(new BlockQueue(stages + 4, channels, maxBlock));
+        }
+    }
+
+    for (int lane = 0; lane < lanes; lane++)
+        for (int s = 0; s < stages; s++)
+            workers.emplace_back([this, lane, s] { runStage(lane, s); });
+}
+
+ModelPipeline::~ModelPipeline() {
+    quit = true;
+    for (auto& worker : workers)
+        worker.join();
+}
+
+int ModelPipeline::getLatencySamples() const {
+    return (getNumStages() + 1) * maxBlock;
+}
+
+float* ModelPipeline::getInputPointer(int channel, int lane) {
+    return inputs[lane].data() + channel * 2 * maxBlock + inputFill;
+}
+
+std::vector<std::vector<float>>* ModelPipeline::beginOutputScales() {
+    return isHandingOff() ? nullptr : &pendingScales;
+}
+
+void ModelPipeline::endOutputScales() {
+    handOff(false);
+}
+
+// the scales of the last hand-off go along again, the stages just reapply them
+bool ModelPipeline::swapMorph() {
+    if (isHandingOff())
+        return false;
+    handOff(true);
+    return true;
+}
+
+void ModelPipeline::handOff(bool morph) {
+    pendingMorph = morph;
+    pendingSequence = inputBlocks;
+    pendingStages.store(getNumStages(), std::memory_order_relaxed);
+    handOffs.store(handOffs.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+}
+
+void ModelPipeline::process(int numSamples, float* const* outputs) {
+    int stages = getNumStages();
+    int nInputs = model.getInputs(), nOutputs = model.getOutputs();
+
+    // hand every completed block to the first stage, if it's still busy with the
+    // ones before, the block is dropped and shows up as an underrun later
+    inputFill += numSamples;
+    while (inputFill >= maxBlock) {
+        for (int lane = 0; lane < lanes; lane++) {
+            BlockQueue& in = *queues[lane * (stages + 1)];
+            float* rows = inputs[lane].data();
+            if (Block* block = in.beginWrite()) {
+                for (int c = 0; c < nInputs; c++)
+                    std::memcpy(block->data.data() + c * maxBlock, rows + c * 2 * maxBlock, maxBlock * sizeof(float));
+                block->numSamples = maxBlock;
+                block->sequence = inputBlocks;
+                in.endWrite();
+            }
+            for (int c = 0; c < nInputs; c++)
+                std::memmove(rows + c * 2 * maxBlock, rows + c * 2 * maxBlock + maxBlock, (inputFill - maxBlock) * sizeof(float));
+        }
+        inputFill -= maxBlock;
+        inputBlocks++;
+    }
+
+    // output frame o is input frame o - latency, read from block o / maxBlock - (stages + 1)
+    for (int done = 0; done < numSamples; ) {
+        int64_t wanted = outputPosition / maxBlock - (stages + 1);
+        int offset = (int) (outputPosition % maxBlock);
+        int n = std::min(numSamples - done, maxBlock - offset);
+
+        for (int lane = 0; lane < lanes; lane++) {
+            // skip any blocks that arrived too late
+            BlockQueue& out = *queues[lane * (stages + 1) + stages];
+            Block* block = out.beginRead();
+            while (block != nullptr && block->sequence < wanted) {
+                out.endRead();
+                block = out.beginRead();
+            }
+
+            bool ready = (block != nullptr && block->sequence == wanted);
+            if (!ready && wanted >= 0 && offset == 0)
+                underruns++;
+
+            for (int c = 0; c < nOutputs; c++) {
+                float* y = outputs[lane * nOutputs + c];
+                if (y == nullptr)
+                    continue;
+                if (ready)
+                    std::memcpy(y + done, block->data.data() + c * maxBlock + offset, n * sizeof(float));
+                else
+                    std::fill(y + done, y + done + n, 0.0f);
+            }
+            if (ready && offset + n == maxBlock)
+                out.endRead();
+        }
+
+        outputPosition += n;
+        done += n;
+    }
+}
+
+// flush denormals on the workers the way the host does for the audio thread
+static void disableDenormals() {
+#if defined(__x86_64__) || defined(__i386__)
+    _mm_setcsr(_mm_getcsr() | 0x8040);
+#elif defined(__aarch64__)
+    uint64_t fpcr;
+    asm volatile("mrs %0, fpcr" : "=r"(fpcr));
+    asm volatile("msr fpcr, %0" : : "r"(fpcr | (1ull << 24)));
+#endif
+}
+
+// spin while blocks keep coming so a new one is picked up immediately,
+// back off to short sleeps once the host has stopped calling us
+static void idle(std::chrono::steady_clock::time_point lastBlock) {
+    if (std::chrono::steady_clock::now() - lastBlock < std::chrono::milliseconds(100))
+        std::this_thread::yield();
+    else
+        std::this_thread::sleep_for(std::chrono::microseconds(250));
+}
+
+// before the block with sequence, false when the pipeline quits while waiting
+bool ModelPipeline::syncStage(int stage, int first, int last, int64_t sequence) {
+    int generation = handOffs.load(std::memory_order_acquire);
+    StageSync& sync = stageSync[stage];
+    if (sync.generation.load(std::memory_order_acquire) == generation || sequence < pendingSequence)
+        return true;
+
+    // all lanes are past their blocks before this one, nobody reads the kernels
+    if (sync.arrived.fetch_add(1, std::memory_order_acq_rel) + 1 == lanes) {
+        for (int i = first; i < last; i++) {
+            if (pendingMorph)
+                model.kernels[i].swapMorph();
+            model.setOutputScale(i, pendingScales[i].data());
+        }
+        sync.arrived.store(0, std::memory_order_relaxed);
+        sync.generation.store(generation, std::memory_order_release);
+        pendingStages.fetch_sub(1, std::memory_order_release);
+        return true;
+    }
+
+    auto since = std::chrono::steady_clock::now();
+    while (sync.generation.load(std::memory_order_acquire) != generation) {
+        if (quit.load(std::memory_order_relaxed))
+            return false;
+        idle(since);
+    }
+    return true;
+}
+
+void ModelPipeline::runStage(int lane, int stage) {
+    disableDenormals();
+
+    int stages = getNumStages();
+    int first = stageStarts[stage];
+    int last = (stage + 1 < stages) ? stageStarts[stage + 1] : model.getLayers();
+    BlockQueue& in = *queues[lane * (stages + 1) + stage];
+    BlockQueue& out = *queues[lane * (stages + 1) + stage + 1];
+    int channels = model.getLayerInputs(first);
+    int outChannels = (last < model.getLayers()) ? model.getLayerInputs(last) : model.getOutputs();
+    std::vector<float*> rows(outChannels);
+
+    auto lastBlock = std::chrono::steady_clock::now();
+
+    while (!quit.load(std::memory_order_relaxed)) {
+        Block* input = in.beginRead();
+        Block* output = input != nullptr ? out.beginWrite() : nullptr;
+
+        if (output == nullptr) {
+            idle(lastBlock);
+            continue;
+        }
+        if (!syncStage(stage, first, last, input->sequence))
+            break;
+        lastBlock = std::chrono::steady_clock::now();
+
+        int n = input->numSamples;
+        for (int c = 0; c < channels; c++)
+            std::memcpy(model.getLayerInputPointer(first, c, lane), input->data.data() + c * maxBlock, n * sizeof(float));
+        for (int c = 0; c < outChannels; c++)
+            rows[c] = output->data.data() + c * maxBlock;
+
+        model.processLayers(first, last, n, rows.data(), lane);
+
+        output->numSamples = n;
+        output->sequence = input->sequence;
+        in.endRead();
+        out.endWrite();
+    }
+}
+
+//==============================================================================
+// greedy split, returns the first layer of each stage
+static std::vector<int> splitLayers(const std::vector<double>& costs, double bound) {
+    std::vector<int> starts = {0};
+    double stage = 0.0;
+    for (int i = 0; i < (int) costs.size(); i++) {
+        if (stage > 0.0 && stage + costs[i] > bound) {
+            starts.push_back(i);
+            stage = 0.0;
+        }
+        stage += costs[i];
+    }
+    return starts;
+}
+
+std::vector<int> ModelPipeline::planStages(const std::vector<double>& layerCosts, double budget, int maxStages) {
+    maxStages = std::max(1, maxStages);
+    auto starts = splitLayers(layerCosts, budget);
+    if ((int) starts.size() <= maxStages)
+        return starts;
+
+    // can't keep up either way, so make the slowest stage as fast as possible
+    double low = *std::max_element(layerCosts.begin(), layerCosts.end()), high = 0.0;
+    for (auto c : layerCosts)
+        high += c;
+    for (int n = 0; n < 32; n++) {
+        double mid = 0.5 * (low + high);
+        if ((int) splitLayers(layerCosts, mid).size() <= maxStages)
+            high = mid;
+        else
+            low = mid;
+    }
+    return splitLayers(layerCosts, high);
+}
@@ -0,0 +1,108 @@
+#ifndef PIPELINE_H
+#define PIPELINE_H
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <thread>
+#include <vector>
+
+struct Model;
+
+// Runs the layers of a Model on worker threads. The layers are split into
+// stages, one worker per stage and lane, and consecutive stages work on
+// consecutive blocks, handing them on through lock-free single producer /
+// single consumer queues. The audio thread only copies frames in and out.
+//
+// The workers always get full blocks of the model's maximum block size, the
+// audio thread collects whatever the host delivers until a block is complete.
+// Frames come back getLatencySamples() later: one block for collecting the
+// input, plus one block per stage, so the stages keep their full budget no
+// matter how the host splits its callbacks.
+struct ModelPipeline {
+
+    public:
+
+        // stage s runs layers [stageStarts[s], stageStarts[s+1]), the last stage runs to the end
+        ModelPipeline(Model& model, const std::vector<int>& stageStarts);
+        ~ModelPipeline();
+
+        // audio thread, same contract as Model::getInputPointer / Model::process,
+        // any number of frames up to the maximum block size
+        float* getInputPointer(int channel, int lane);
+        void process(int numSamples, float* const* outputs);
+
+        // audio thread, new FiLM values for all layers (see Model::setCondition): fill the rows
+        // beginOutputScales() returns, shaped like Model::film, and endOutputScales() hands them
+        // to the stages, which apply them to every block from the next one on. nullptr while
+        // the stages are still applying the last hand-off
+        std::vector<std::vector<float>>* beginOutputScales();
+        void endOutputScales();
+
+        // audio thread, the stages swap in the weights of a finished morph pass (see Model::setMorph)
+        // the same way, false while they are still applying the last hand-off. the next pass
+        // writes the weights swapped out, so it waits until isHandingOff() is false
+        bool swapMorph();
+        bool isHandingOff() const {return pendingStages.load(std::memory_order_acquire) != 0;};
+
+        int getNumStages() const {return (int) stageStarts.size();};
+        int getLatencySamples() const;
+
+        // fewest stages whose summed layer costs stay within budget, or when
+        // that needs more than maxStages, the most even split into maxStages
+        static std::vector<int> planStages(const std::vector<double>& layerCosts, double budget, int maxStages);
+
+        // number of underruns (blocks that weren't ready in time) so far
+        std::atomic<int> underruns {0};
+
+    private:
+        struct Block {
+            int numSamples;
+            int64_t sequence;
+            std::vector<float> data;        // {channels, maxBlock}
+        };
+
+        // lock-free ring of blocks between exactly one producer and one consumer
+        struct BlockQueue {
+            BlockQueue(int capacity, int channels, int maxBlock);
+            Block* beginWrite();
+            void endWrite();
+            Block* beginRead();
+            void endRead();
+
+            std::vector<Block> slots;
+            std::atomic<uint32_t> head {0}, tail {0};
+        };
+
+        // the workers of a stage share its kernels, so every lane stops ahead of the first
+        // block with new output scales or weights and the last one to arrive applies them
+        struct StageSync {
+            std::atomic<int> arrived {0}, generation {0};
+        };
+
+        void runStage(int lane, int stage);
+        void handOff(bool morph);
+        bool syncStage(int stage, int first, int last, int64_t sequence);
+
+        Model& model;
+        std::vector<int> stageStarts;
+        int lanes, maxBlock;
+
+        std::vector<std::vector<float>> inputs;             // [lane] {inputs, 2 * maxBlock}, filled by the audio thread
+        std::vector<std::unique_ptr<BlockQueue>> queues;    // [lane * (stages + 1) + s], s feeds stage s
+        int inputFill = 0;                                  // frames collected towards the next block
+        int64_t inputBlocks = 0;                            // blocks handed to the first stage
+        int64_t outputPosition = 0;                         // frames returned to the host
+
+        std::vector<std::vector<float>> pendingScales;      // [layer] like Model::film
+        bool pendingMorph = false;                          // the stages swap the morph weights too
+        int64_t pendingSequence = 0;                        // first block they apply to
+        std::atomic<int> handOffs {0};                      // counts the hand-offs
+        std::atomic<int> pendingStages {0};                 // stages that haven't applied the last one
+        std::unique_ptr<StageSync[]> stageSync;
+
+        std::atomic<bool> quit {false};
+        std::vector<std::thread> workers;
+};
+
+#endif
@@ -2,9 +2,17 @@
 #include <string>
 #include <cstring>
 #include <cstdint>
+#include <cmath>
+#include <algorithm>
+#include <chrono>
+#include <limits>
 #include <torch/torch.h>
 
 #include "ronnlib.h"
+#include "pipeline.h"
+#include "philox.h"
+
+static_assert((int) Model::Sine30 == (int) activations::Sine30, "Model::Activation and activations::Type must list the same functions");
 
 Model::Model(int nInputs, 
              int nOutputs, 
@@ -16,7 +24,9 @@ Model::Model(int nInputs,
              int act,
              int init,
              int seed,
-             bool dwise) {
+             bool dwise,
+             bool res,
+             const WeightSnapshot* weights) {
 
         inputs = nInputs;
         outputs = nOutputs;
@@ -28,8 +38,9 @@ Model::Model(int nInputs,
         initType = static_cast<InitType>(int(init));
         dilationFactor = dFactor;
         depthwise = dwise;
+        residual = res;
 
-        buildModel(seed);
+        buildModel(seed, weights);
 
         // and setup the activation functions
         leakyrelu = torch::nn::LeakyReLU(
@@ -37,7 +48,9 @@ Model::Model(int nInputs,
                         .negative_slope(0.2));
 }
 
-void Model::buildModel(int seed) {
+Model::~Model() = default;
+
+void Model::buildModel(int initSeed, const WeightSnapshot* weights) {
 
     int inChannels, outChannels;
 
@@ -64,95 +77,1042 @@ void Model::buildModel(int seed) {
             inChannels = getChannels();
             outChannels = getChannels();
         }
+        kernels.push_back(Conv1dKernel());
         if (!depthwise) 
         {
+            kernels.back().setup(inChannels, outChannels, getKernelWidth(), getDilation(i), 1, getBias());
             conv.push_back(torch::nn::Conv1d(
                 torch::nn::Conv1dOptions(inChannels,outChannels,getKernelWidth())
                 .stride(1)
                 .dilation(pow(getDilationFactor(),i))
                 .bias(getBias())));
         }
-        else 
-        {   // first depthwise conv
-            int groups;
-            if (i+1 == getLayers())
-            {
-                groups = 1;
-            }
-            else if (i == 0) 
-            {
-                groups = 1;
-            }
-            else 
-            {
-                groups = inChannels;
-            }
-            std::cout << i << " " << inChannels << " " << outChannels << " " << groups << std::endl;
+        else if (i == 0 || i + 1 == getLayers())
+        {   // the first and last layer stay dense
+            kernels.back().setup(inChannels, outChannels, getKernelWidth(), getDilation(i), 1, getBias());
             conv.push_back(torch::nn::Conv1d(
                 torch::nn::Conv1dOptions(inChannels,outChannels,getKernelWidth())
                 .stride(1)
-                .groups(groups)
                 .dilation(pow(getDilationFactor(),i))
                 .bias(getBias())));
-
-            // followed by pointwise conv
-            //conv.push_back(torch::nn::Conv1d(
-            //    torch::nn::Conv1dOptions(outChannels,outChannels,1)
-            //    .stride(1)
-            //    .bias(getBias())));
         }
+        else 
+        {   // depthwise conv, the bias goes after the pointwise conv that follows
+            kernels.back().setup(inChannels, outChannels, getKernelWidth(), getDilation(i), inChannels, getBias(), true);
+            conv.push_back(torch::nn::Conv1d(
+                torch::nn::Conv1dOptions(inChannels,inChannels,getKernelWidth())
+                .stride(1)
+                .groups(inChannels)
+                .dilation(pow(getDilationFactor(),i))
+                .bias(false)));
+            pointwise.push_back(torch::nn::Conv1d(
+                torch::nn::Conv1dOptions(inChannels,outChannels,1)
+                .stride(1)
+                .bias(getBias())));
+            continue;
+        }
+        pointwise.push_back(torch::nn::Conv1d(nullptr));
+    }
+
+    setActivation(getActivation());
+    setResidual(getResidual());
+
+    // FiLM generator, conditionSize -> conditionSize^2 -> ... -> conditionDim, and a projection
+    // to the gain and bias of every output channel of each layer
+    for (int n = 0, in = conditionSize; n < 3; n++) {
+        int out = (n == 2) ? conditionDim : in * in;
+        generator.push_back(torch::nn::Linear(in, out));
+        in = out;
+    }
+    for (auto i = 0; i < getLayers(); i++) {
+        adpt.push_back(torch::nn::Linear(conditionDim, 2 * kernels[i].getOutputs()));
+        film.push_back(std::vector<float>(2 * kernels[i].getOutputs(), 0.0f));
     }
+    condition.assign(conditionSize, 0.0f);
+    conditionHidden[0].assign(conditionDim, 0.0f);
+    conditionHidden[1].assign(conditionDim, 0.0f);
+    registerModules(false);
+
+    seed = initSeed;
+    if (weights == nullptr || !loadWeights(*weights))
+        initModel(initSeed);
+}
 
-    // now register each convolutional layer
+// in the order of parameters(), which the weight snapshots are stored in. with replace
+// the modules registered before under the same names are swapped for the current ones
+void Model::registerModules(bool replace) {
+    auto add = [this, replace](const std::string& name, std::shared_ptr<torch::nn::Module> module) {
+        if (replace)
+            replace_module(name, module);
+        else
+            register_module(name, module);
+    };
+    for (auto i = 0; i < getLayers(); i++) {
+        add("conv"+std::to_string(i), conv[i].ptr());
+    }
     for (auto i = 0; i < getLayers(); i++) {
-        register_module("conv"+std::to_string(i), conv[i]);
+        if (!pointwise[i].is_empty())
+            add("pointwise"+std::to_string(i), pointwise[i].ptr());
+    }
+    for (auto n = 0; n < (int) generator.size(); n++)
+        add("generator"+std::to_string(n), generator[n].ptr());
+    for (auto i = 0; i < getLayers(); i++)
+        add("adpt"+std::to_string(i), adpt[i].ptr());
+}
+
+Model::Model() = default;
+
+// the modules (and with them the weights) are shared, the packed kernels copied
+std::unique_ptr<Model> Model::share(const std::shared_ptr<Model>& source) {
+    const Model& s = *source;
+    std::unique_ptr<Model> model(new Model());
+    model->inputs = s.inputs;
+    model->outputs = s.outputs;
+    model->layers = s.layers;
+    model->channels = s.channels;
+    model->kernelWidth = s.kernelWidth;
+    model->dilationFactor = s.dilationFactor;
+    model->seed = s.seed;
+    model->bias = s.bias;
+    model->depthwise = s.depthwise;
+    model->residual = s.residual;
+    model->activation = s.activation;
+    model->initType = s.initType;
+    model->backend = s.backend;
+
+    model->conv = s.conv;
+    model->pointwise = s.pointwise;
+    model->generator = s.generator;
+    model->adpt = s.adpt;
+    model->leakyrelu = s.leakyrelu;
+    model->registerModules(false);
+    model->kernels = s.kernels;
+    model->precision = s.precision;
+
+    model->generatorWeights = s.generatorWeights;
+    model->adptWeights = s.adptWeights;
+    model->film = s.film;
+    model->condition.assign(s.conditionSize, 0.0f);
+    model->conditionHidden[0].assign(s.conditionDim, 0.0f);
+    model->conditionHidden[1].assign(s.conditionDim, 0.0f);
+    model->weightsOwner = source;
+    model->applyGains();
+    return model;
+}
+
+// copies of the modules a shared model runs on, so its weights can change
+void Model::unshare() {
+    for (auto& layer : conv)
+        layer = torch::nn::Conv1d(std::dynamic_pointer_cast<torch::nn::Conv1dImpl>(layer->clone()));
+    for (auto& layer : pointwise) {
+        if (!layer.is_empty())
+            layer = torch::nn::Conv1d(std::dynamic_pointer_cast<torch::nn::Conv1dImpl>(layer->clone()));
     }
-    initModel(seed);
+    for (auto& layer : generator)
+        layer = torch::nn::Linear(std::dynamic_pointer_cast<torch::nn::LinearImpl>(layer->clone()));
+    for (auto& layer : adpt)
+        layer = torch::nn::Linear(std::dynamic_pointer_cast<torch::nn::LinearImpl>(layer->clone()));
+    registerModules(true);
+    weightsOwner.reset();
+}
+
+// the shapes stay, so the weights go straight into the tensors and kernels the model has
+void Model::reinitialise(int newSeed, InitType init) {
+    pipeline.reset();
+    if (weightsOwner != nullptr)
+        unshare();
+    initType = init;
+    initModel(newSeed);
+    resetState();
 }
 
 // the forward operation
 torch::Tensor Model::forward(torch::Tensor x) {
     // we iterate over the convolutions
     for (auto i = 0; i < getLayers(); i++) {
-        if (i + 1 < getLayers()) {
-            //setActivation(static_cast<Activation>(rand() % Sine));
-            switch (getActivation()) {
-                case Linear:        x =                   (conv[i](x)); break;
-                case LeakyReLU:     x = leakyrelu         (conv[i](x)); break;
-                case Tanh:          x = torch::tanh       (conv[i](x)); break;
-                case Sigmoid:       x = torch::sigmoid    (conv[i](x)); break;
-                case ReLU:          x = torch::relu       (conv[i](x)); break;
-                case ELU:           x = torch::elu        (conv[i](x)); break;
-                case SELU:          x = torch::selu       (conv[i](x)); break;
-                case GELU:          x = torch::gelu       (conv[i](x)); break;
-                case RReLU:         x = torch::rrelu      (conv[i](x)); break;
-                case Softplus:      x = torch::softplus   (conv[i](x)); break;
-                case Softshrink:    x = torch::softshrink (conv[i](x)); break;
-                case Sine:          x = torch::sin        (conv[i](x)); break;
-                case Sine30:        x = torch::sin        (30 * conv[i](x)); break;
-                default:            x =                   (conv[i](x)); break;
-            }
+        x = applyLayer(i, x);
+    }
+    return x;
+}
+
+// the native kernels apply the activation of every hidden layer as part of
+// the convolution, the last layer stays linear
+void Model::setActivation(Activation newActivation) {
+    unmerge();
+    activation = newActivation;
+    for (auto i = 0; i < (int) kernels.size(); i++) {
+        bool last = (i + 1 == (int) kernels.size());
+        kernels[i].setActivation(last ? activations::Linear : static_cast<activations::Type>(activation));
+    }
+}
+
+// residual connections skip every layer whose input can be added to its output,
+// the native kernels add them as they store the outputs
+void Model::setResidual(bool newResidual) {
+    unmerge();
+    residual = newResidual;
+    for (auto& kernel : kernels)
+        kernel.setResidual(residual);
+    applyGains();
+}
+
+// convolution of a single layer followed by FiLM, its activation and the residual
+torch::Tensor Model::applyLayer(int i, torch::Tensor x) {
+    if (getBackend() == Native)
+        return convolve(i, x);
+
+    // the native kernels apply FiLM as their output scale, here it follows the convolution
+    auto input = x;
+    x = convolve(i, x);
+    if (kernels[i].scaled) {
+        int out = kernels[i].getOutputs();
+        x = x * torch::from_blob(film[i].data(), {1, out, 1}) + torch::from_blob(film[i].data() + out, {1, out, 1});
+    }
+
+    if (i + 1 < getLayers()) {
+        //setActivation(static_cast<Activation>(rand() % Sine));
+        switch (getActivation()) {
+            case Linear:        break;
+            case LeakyReLU:     x = leakyrelu         (x); break;
+            case Tanh:          x = torch::tanh       (x); break;
+            case Sigmoid:       x = torch::sigmoid    (x); break;
+            case ReLU:          x = torch::relu       (x); break;
+            case ELU:           x = torch::elu        (x); break;
+            case SELU:          x = torch::selu       (x); break;
+            case GELU:          x = torch::gelu       (x); break;
+            case RReLU:         x = torch::rrelu      (x); break;
+            case Softplus:      x = torch::softplus   (x); break;
+            case Softshrink:    x = torch::softshrink (x); break;
+            case Sine:          x = torch::sin        (x); break;
+            case Sine30:        x = torch::sin        (30 * x); break;
+            default:            break;
         }
-        else
-            x = conv[i](x);
     }
+
+    // the centre of each output's window, a single input channel is broadcast
+    if (kernels[i].residual)
+        x = x + input.narrow(2, kernels[i].residualOffset, x.size(2));
     return x;
 }
 
-void Model::initModel(int seed){
-    torch::manual_seed(seed); // always reset the seed before init
+// run the convolution of a single layer on the selected backend,
+// the native kernels include the activation of hidden layers
+torch::Tensor Model::convolve(int i, torch::Tensor x) {
+    if (getBackend() == Torch)
+        return pointwise[i].is_empty() ? conv[i](x) : pointwise[i](conv[i](x));
+
+    x = x.contiguous();
+    int frames = x.size(2) - kernels[i].getContext();
+    auto y = torch::empty({x.size(0), kernels[i].getOutputs(), frames});
+    for (auto b = 0; b < x.size(0); b++) {
+        kernels[i].process(x[b].data_ptr<float>(), x.size(2),
+                           y[b].data_ptr<float>(), frames,
+                           frames);
+    }
+    return y;
+}
+
+// allocate the per-layer buffers used for streaming
+void Model::prepareStreaming(int maxBlockSize, int numLanes, bool fixed, int oversampling) {
+    pipeline.reset();
+    oversampler.reset();
+    lanes = std::max(numLanes, 1);
+    fixedBlock = fixed;
+
+    // the network sees oversampling times as many frames
+    if (oversampling > 1)
+        oversampler.reset(new Oversampler(oversampling, lanes * getInputs(), lanes * getOutputs(), std::max(maxBlockSize, 1)));
+    maxBlock = std::max(maxBlockSize, 1) * getOversampling();
+    buffers.clear();
+    bufferData.clear();
+    layerOutputs.clear();
+
     for (auto i = 0; i < getLayers(); i++) {
-        switch(getInitType())
-        {
-            case normal:            torch::nn::init::normal_            (conv[i]->weight);
-            case uniform1:          torch::nn::init::uniform_           (conv[i]->weight, -0.25, 0.25);
-            case uniform2:          torch::nn::init::uniform_           (conv[i]->weight, -1.00, 1.00);
-            case xavier_normal:     torch::nn::init::xavier_normal_     (conv[i]->weight);
-            case xavier_uniform:    torch::nn::init::xavier_uniform_    (conv[i]->weight);
-            case kaiming_normal:    torch::nn::init::kaiming_normal_    (conv[i]->weight);
-            case kamming_uniform:   torch::nn::init::kaiming_uniform_   (conv[i]->weight);
+        int inChannels = kernels[i].getInputs();
+        int stride = getHistoryStride(kernels[i].getContext());
+        buffers.push_back(torch::zeros({lanes, inChannels, stride}));
+        bufferData.push_back(buffers[i].data_ptr<float>());
+    }
+    historyOffsets.assign(lanes * getLayers(), 0);
+    mergedOffsets.assign(lanes, 0);
+    laneInputs.assign(lanes, nullptr);
+    laneOutputs.assign(lanes, nullptr);
+    laneScratch.assign(lanes, nullptr);
+
+    // each layer writes its output right after the context of the next one
+    layerOutputs.resize(lanes);
+    for (auto lane = 0; lane < lanes; lane++) {
+        for (auto i = 0; i + 1 < getLayers(); i++) {
+            std::vector<float*> rows;
+            for (auto c = 0; c < kernels[i].getOutputs(); c++)
+                rows.push_back(getLayerInputPointer(i+1, c, lane));
+            layerOutputs[lane].push_back(rows);
         }
     }
+
+    blockOutputs.assign(fixedBlock ? lanes * getOutputs() * maxBlock : 0, 0.0f);
+    blockOutputRows.clear();
+    for (auto row = 0; row < (int) blockOutputs.size() / maxBlock; row++)
+        blockOutputRows.push_back(blockOutputs.data() + row * maxBlock);
+
+    int baseBlock = maxBlock / getOversampling();
+    oversampledInputs.assign(oversampler != nullptr ? lanes * getInputs() * baseBlock : 0, 0.0f);
+    oversampledOutputs.assign(oversampler != nullptr ? lanes * getOutputs() * maxBlock : 0, 0.0f);
+    oversampledRows.clear();
+    for (auto row = 0; row < (int) oversampledOutputs.size() / maxBlock; row++)
+        oversampledRows.push_back(oversampledOutputs.data() + row * maxBlock);
+
+    if (merged)
+        mergedBuffer.assign(lanes * getInputs() * getHistoryStride(mergedKernel.getContext()), 0.0f);
+    allocateScratch();
+    resetState();
+}
+
+// reset the history to the state the network reaches after a long run of silence.
+// with bias enabled the hidden layers do not settle at zero, so we propagate a
+// constant through each layer to find the value its history should hold.
+void Model::resetState() {
+    torch::NoGradGuard no_grad;
+    std::fill(historyOffsets.begin(), historyOffsets.end(), 0);
+    std::fill(mergedOffsets.begin(), mergedOffsets.end(), 0);
+    auto x = torch::zeros({1, getInputs(), 1});
+    for (auto i = 0; i < getLayers() && i < (int) buffers.size(); i++) {
+        int context = kernels[i].getContext();
+        int channels = x.size(1);
+        buffers[i].narrow(2, 0, context).copy_(x[0].expand({channels, context}));
+        x = applyLayer(i, x.expand({1, channels, context + 1}).contiguous());
+    }
+
+    std::fill(mergedBuffer.begin(), mergedBuffer.end(), 0.0f);
+    if (oversampler != nullptr)
+        oversampler->reset();
+
+    // a fixed block model starts out handing back the silent output
+    blockFill = 0;
+    for (auto row = 0; row < (int) blockOutputRows.size() && x.size(1) == getOutputs(); row++)
+        std::fill(blockOutputRows[row], blockOutputRows[row] + maxBlock, x[0][row % getOutputs()][0].item<float>());
+}
+
+float* Model::getLayerInputPointer(int layer, int channel, int lane) {
+    int context = kernels[layer].getContext();
+    int stride = getHistoryStride(context);
+    return bufferData[layer] + (lane * kernels[layer].getInputs() + channel) * stride
+         + historyOffsets[lane * getLayers() + layer] + context;
+}
+
+// the window of the block (context past frames followed by the new ones) moves on along the
+// rows, which have room for another context, and only goes back to the start when it reaches
+// the end, taking its context with it. that copies a context every context frames or so
+// instead of every block, so the traffic per block follows the block and not the history
+void Model::advanceHistory(float* rows, int channels, int context, int& offset, int numSamples) {
+    int stride = getHistoryStride(context);
+    offset += numSamples;
+    if (offset + context + maxBlock <= stride)
+        return;
+    for (auto c = 0; c < channels; c++)
+        std::memcpy(rows + c * stride, rows + c * stride + offset, context * sizeof(float));
+    offset = 0;
+}
+
+float* Model::getInputPointer(int channel, int lane) {
+    if (oversampler != nullptr)
+        return oversampledInputs.data() + (lane * getInputs() + channel) * (maxBlock / getOversampling());
+    return getNetworkInputPointer(channel, lane);
+}
+
+float* Model::getNetworkInputPointer(int channel, int lane) {
+    if (pipeline != nullptr)
+        return pipeline->getInputPointer(channel, lane);
+    if (merged) {
+        int context = mergedKernel.getContext();
+        return mergedBuffer.data() + (lane * getInputs() + channel) * getHistoryStride(context)
+             + mergedOffsets[lane] + context + blockFill;
+    }
+    return getLayerInputPointer(0, channel, lane) + blockFill;
+}
+
+void Model::process(int numSamples, float* const* outputs) {
+    // the gains that couldn't be folded into the weights
+    if (frameGains[0] != 1.0f) {
+        for (auto lane = 0; lane < lanes; lane++) {
+            for (auto c = 0; c < getInputs(); c++) {
+                float* x = getInputPointer(c, lane);
+                for (auto t = 0; t < numSamples; t++)
+                    x[t] *= frameGains[0];
+            }
+        }
+    }
+
+    if (oversampler == nullptr)
+        processNetwork(numSamples, outputs);
+    else {
+        int factor = getOversampling();
+        for (auto lane = 0; lane < lanes; lane++) {
+            for (auto c = 0; c < getInputs(); c++)
+                oversampler->upsample(lane * getInputs() + c, getInputPointer(c, lane), getNetworkInputPointer(c, lane), numSamples);
+        }
+
+        processNetwork(numSamples * factor, oversampledRows.data());
+
+        for (auto row = 0; row < (int) oversampledRows.size(); row++) {
+            if (outputs[row] != nullptr)
+                oversampler->downsample(row, oversampledRows[row], outputs[row], numSamples);
+        }
+    }
+
+    if (frameGains[1] != 1.0f) {
+        for (auto row = 0; row < lanes * getOutputs(); row++) {
+            for (auto t = 0; outputs[row] != nullptr && t < numSamples; t++)
+                outputs[row][t] *= frameGains[1];
+        }
+    }
+}
+
+void Model::processNetwork(int numSamples, float* const* outputs) {
+    if (pipeline != nullptr) {
+        pipeline->process(numSamples, outputs);
+        return;
+    }
+    if (!fixedBlock) {
+        processLanes(numSamples, outputs);
+        return;
+    }
+
+    // these frames come from the previous block, then the network runs once the current one is full
+    for (auto row = 0; row < (int) blockOutputRows.size(); row++) {
+        if (outputs[row] != nullptr)
+            std::memcpy(outputs[row], blockOutputRows[row] + blockFill, numSamples * sizeof(float));
+    }
+    blockFill += numSamples;
+    if (blockFill == maxBlock) {
+        processLanes(maxBlock, blockOutputRows.data());
+        blockFill = 0;
+    }
+}
+
+// the pipeline collects blocks itself, a fixed block model takes no more than the rest of its block
+int Model::getMaxFrames() {
+    return (pipeline != nullptr ? maxBlock : maxBlock - blockFill) / getOversampling();
+}
+
+void Model::processLayers(int first, int last, int numSamples, float* const* outputs, int lane) {
+    for (auto i = first; i < last; i++) {
+        int context = kernels[i].getContext();
+        int stride = getHistoryStride(context);
+        float* input = bufferData[i] + lane * kernels[i].getInputs() * stride + historyOffsets[lane * getLayers() + i];
+        float* const* out = (i + 1 == last) ? outputs : layerOutputs[lane][i].data();
+
+        // the next layer's window has moved on since the last block
+        if (i + 1 < last) {
+            auto& rows = layerOutputs[lane][i];
+            for (auto c = 0; c < (int) rows.size(); c++)
+                rows[c] = getLayerInputPointer(i + 1, c, lane);
+        }
+
+        if (getBackend() == Native) {
+            void* scratch = kernelScratch.empty() ? nullptr : kernelScratch[lane * getLayers() + i].data();
+            kernels[i].process(input, stride, out, numSamples, scratch);
+        }
+        else {
+            // libtorch allocates its outputs, so this path is not real-time safe
+            torch::NoGradGuard no_grad;
+            int inChannels = kernels[i].getInputs();
+            auto window = torch::from_blob(input, {1, inChannels, context + numSamples}, {inChannels * stride, stride, 1});
+            auto y = applyLayer(i, window).contiguous();
+            for (auto c = 0; c < kernels[i].getOutputs(); c++) {
+                if (out[c] != nullptr)
+                    std::memcpy(out[c], y.data_ptr<float>() + c * numSamples, numSamples * sizeof(float));
+            }
+        }
+    }
+
+    // keep the most recent frames of each layer as context for the next block
+    for (auto i = first; i < last; i++) {
+        int inChannels = kernels[i].getInputs();
+        float* rows = bufferData[i] + lane * inChannels * getHistoryStride(kernels[i].getContext());
+        advanceHistory(rows, inChannels, kernels[i].getContext(), historyOffsets[lane * getLayers() + i], numSamples);
+    }
+}
+
+// time each layer on a full block, the results pick the pipeline stages
+std::vector<double> Model::measureLayerCosts() {
+    std::vector<double> costs;
+    std::vector<float> scratch(getChannels() * maxBlock + getOutputs() * maxBlock);
+
+    for (auto i = 0; i < getLayers(); i++) {
+        std::vector<float*> rows;
+        for (auto c = 0; c < kernels[i].getOutputs(); c++)
+            rows.push_back(scratch.data() + c * maxBlock);
+
+        std::vector<double> times;
+        for (auto n = 0; n < 16; n++) {
+            auto start = std::chrono::steady_clock::now();
+            processLayers(i, i + 1, maxBlock, rows.data(), 0);
+            auto end = std::chrono::steady_clock::now();
+            times.push_back(std::chrono::duration<double>(end - start).count());
+        }
+        std::sort(times.begin(), times.end());
+        costs.push_back(times[times.size() / 2]);
+    }
+
+    resetState();
+    return costs;
+}
+
+// split the layers over worker threads when a block can't be computed in time on
+// the audio thread, each stage gets at most a fraction of the block period
+void Model::preparePipeline(double sampleRate, int maxThreads) {
+    pipeline.reset();
+    if (maxThreads < lanes || sampleRate <= 0.0 || merged)
+        return;
+
+    auto costs = measureLayerCosts();
+    double budget = 0.7 * maxBlock / (sampleRate * getOversampling());
+    double total = 0.0;
+    for (auto c : costs)
+        total += c;
+    if (total * lanes <= budget)
+        return;
+
+    auto stages = ModelPipeline::planStages(costs, budget, std::min(getLayers(), maxThreads / lanes));
+    for (auto& kernel : kernels)
+        kernel.setGains(1.0f, 1.0f);
+    pipeline.reset(new ModelPipeline(*this, stages));
+    applyGains();
+}
+
+int Model::getLatencySamples() {
+    // in frames of the caller's rate, the network's own delay shrinks by the oversampling factor
+    int network = pipeline != nullptr ? pipeline->getLatencySamples() : (fixedBlock ? maxBlock : 0);
+    if (oversampler == nullptr)
+        return network;
+    return (int) std::lround(network / (double) getOversampling() + oversampler->getLatency());
+}
+
+// process a block of new input frames {1, inputs, n} and return the
+// matching {1, outputs, n} output frames, equivalent to running forward()
+// over the full receptive field and keeping the last n frames
+torch::Tensor Model::forwardStreaming(torch::Tensor x) {
+    torch::NoGradGuard no_grad;
+    int n = x.size(2);
+    if ((int) buffers.size() != getLayers())
+        prepareStreaming(n);
+
+    x = x.contiguous();
+    auto y = torch::empty({1, getOutputs(), n});
+    std::vector<float*> rows(getOutputs());
+
+    for (auto start = 0, numSamples = 0; start < n; start += numSamples) {
+        numSamples = std::min(getMaxFrames(), n - start);
+        for (auto c = 0; c < getInputs(); c++)
+            std::memcpy(getInputPointer(c), x.data_ptr<float>() + c * n + start, numSamples * sizeof(float));
+        for (auto c = 0; c < getOutputs(); c++)
+            rows[c] = y.data_ptr<float>() + c * n + start;
+        process(numSamples, rows.data());
+    }
+    return y;
+}
+
+// the initialisers of torch::nn::init for a conv weight {out, in / groups, kWidth}, with
+// fan in and out as torch computes them, and the bias torch gives a new conv layer
+static void initConv(torch::nn::Conv1d& layer, Model::InitType type, const Philox& weightStream, const Philox& biasStream) {
+    auto& weight = layer->weight;
+    float* w = weight.data_ptr<float>();
+    size_t n = (size_t) weight.numel();
+    double fanIn = (double) (weight.size(1) * weight.size(2));
+    double fanOut = (double) (weight.size(0) * weight.size(2));
+    switch (type)
+    {
+        case Model::normal:          weightStream.normal (w, n, 0.0f, 1.0f); break;
+        case Model::uniform1:        weightStream.uniform(w, n, -0.25f, 0.25f); break;
+        case Model::uniform2:        weightStream.uniform(w, n, -1.00f, 1.00f); break;
+        case Model::xavier_normal:   weightStream.normal (w, n, 0.0f, (float) std::sqrt(2.0 / (fanIn + fanOut))); break;
+        case Model::xavier_uniform:  weightStream.uniform(w, n, -(float) std::sqrt(6.0 / (fanIn + fanOut)), (float) std::sqrt(6.0 / (fanIn + fanOut))); break;
+        case Model::kaiming_normal:  weightStream.normal (w, n, 0.0f, (float) std::sqrt(2.0 / fanIn)); break;
+        case Model::kamming_uniform: weightStream.uniform(w, n, -(float) std::sqrt(6.0 / fanIn), (float) std::sqrt(6.0 / fanIn)); break;
+    }
+    if (layer->bias.defined()) {
+        float bound = (float) (1.0 / std::sqrt(fanIn));
+        biasStream.uniform(layer->bias.data_ptr<float>(), (size_t) layer->bias.numel(), -bound, bound);
+    }
+}
+
+// every tensor comes from its own stream of the seed, so the layers are drawn in parallel
+// straight into their weights, and a seed gives the same weights whatever was drawn before.
+// layer i has streams 4i and 4i + 1 for its conv, 4i + 2 and 4i + 3 for the pointwise conv
+// of a separable layer, the FiLM layers follow
+void Model::initModel(int initSeed){
+    seed = initSeed;
+    torch::manual_seed(seed); // for anything else drawing from torch's generator, e.g. RReLU
+    torch::NoGradGuard no_grad;
+    auto type = getInitType();
+    at::parallel_for(0, getLayers(), 1, [this, type](int64_t first, int64_t last) {
+        for (auto i = first; i < last; i++) {
+            uint32_t stream = 4 * (uint32_t) i;
+            initConv(conv[i], type, Philox(seed, stream), Philox(seed, stream + 1));
+            if (!pointwise[i].is_empty())
+                initConv(pointwise[i], type, Philox(seed, stream + 2), Philox(seed, stream + 3));
+        }
+    });
+
+    // the weights keep the scale of their inputs and the biases start at zero, so the
+    // conditioning moves the gains around one and zero leaves the network as it is
+    uint32_t stream = 4 * (uint32_t) getLayers();
+    auto initLinear = [this, &stream](torch::nn::Linear& layer) {
+        float stddev = (float) (1.0 / std::sqrt((double) layer->weight.size(1)));
+        Philox(seed, stream++).normal(layer->weight.data_ptr<float>(), (size_t) layer->weight.numel(), 0.0f, stddev);
+        layer->bias.zero_();
+    };
+    for (auto& layer : generator)
+        initLinear(layer);
+    for (auto& layer : adpt)
+        initLinear(layer);
+    packWeights();
+}
+
+// copy the conv weights into the layout used by the native kernels, which ends any morph
+void Model::packWeights(){
+    unmerge();
+    morphing = false;
+    morphAmount = 0.0f;
+    for (auto i = 0; i < getLayers(); i++) {
+        auto weight = conv[i]->weight.detach().contiguous();
+        auto& last = pointwise[i].is_empty() ? conv[i] : pointwise[i];
+        auto b = getBias() ? last->bias.detach().contiguous() : torch::Tensor();
+        if (pointwise[i].is_empty())
+            kernels[i].packWeights(weight.data_ptr<float>(), getBias() ? b.data_ptr<float>() : nullptr);
+        else {
+            auto mix = pointwise[i]->weight.detach().contiguous();
+            kernels[i].packWeights(weight.data_ptr<float>(), getBias() ? b.data_ptr<float>() : nullptr, mix.data_ptr<float>());
+        }
+    }
+
+    // FiLM layers as rows of their input weights followed by the bias, rewritten in
+    // place unless another model shares them
+    auto packLinear = [](torch::nn::Linear& layer, std::vector<float>& rows) {
+        auto weight = layer->weight.detach().contiguous();
+        auto bias = layer->bias.detach().contiguous();
+        int out = weight.size(0), in = weight.size(1);
+        rows.resize(out * (in + 1));
+        for (auto o = 0; o < out; o++) {
+            std::memcpy(rows.data() + o * (in + 1), weight.data_ptr<float>() + o * in, in * sizeof(float));
+            rows[o * (in + 1) + in] = bias.data_ptr<float>()[o];
+        }
+    };
+    if (generatorWeights == nullptr || generatorWeights.use_count() > 1 || adptWeights.use_count() > 1) {
+        generatorWeights = std::make_shared<std::vector<std::vector<float>>>(generator.size());
+        adptWeights = std::make_shared<std::vector<std::vector<float>>>(adpt.size());
+    }
+    for (auto n = 0; n < (int) generator.size(); n++)
+        packLinear(generator[n], (*generatorWeights)[n]);
+    for (auto i = 0; i < (int) adpt.size(); i++)
+        packLinear(adpt[i], (*adptWeights)[i]);
+    applyGains();
+
+    // new weights, so the conditioning has to be evaluated again
+    if (conditioned) {
+        conditioned = false;
+        setCondition(condition.data());
+    }
+}
+
+WeightSnapshot::Hyperparameters Model::getHyperparameters() {
+    return {getInputs(), getOutputs(), getLayers(), getChannels(), getKernelWidth(), getDilationFactor(),
+            (int) getActivation(), (int) getInitType(), getSeed(),
+            getBias(), depthwise, getResidual()};
+}
+
+// the weights of every parameter, in the order of parameters()
+void Model::saveWeights(std::vector<char>& data) {
+    std::vector<torch::Tensor> tensors;
+    std::vector<const float*> pointers;
+    std::vector<size_t> sizes;
+    for (const auto& p : parameters()) {
+        tensors.push_back(p.detach().contiguous());
+        pointers.push_back(tensors.back().data_ptr<float>());
+        sizes.push_back((size_t) p.numel());
+    }
+    WeightSnapshot::write(getHyperparameters(), pointers, sizes, data);
+}
+
+// copies the weights straight into the parameters, leaves the model as it is
+// when the snapshot belongs to a different one
+bool Model::loadWeights(const WeightSnapshot& snapshot) {
+    auto params = parameters();
+    if (!snapshot.isValid() || snapshot.getHeader().model != getHyperparameters()
+        || snapshot.getNumTensors() != (int) params.size())
+        return false;
+    for (auto i = 0; i < (int) params.size(); i++) {
+        if (snapshot.getTensorSize(i) != (size_t) params[i].numel())
+            return false;
+    }
+
+    torch::NoGradGuard no_grad;
+    for (auto i = 0; i < (int) params.size(); i++)
+        std::memcpy(params[i].data_ptr<float>(), snapshot.getTensor(i), params[i].numel() * sizeof(float));
+    packWeights();
+    return true;
+}
+
+// y = W x + b for a layer packed as {out, in + 1} rows
+static void applyLinear(const std::vector<float>& layer, const float* x, int in, float* y, bool relu) {
+    int out = (int) layer.size() / (in + 1);
+    for (auto o = 0; o < out; o++) {
+        const float* row = layer.data() + o * (in + 1);
+        float acc = row[in];
+        for (auto c = 0; c < in; c++)
+            acc += row[c] * x[c];
+        y[o] = relu ? std::max(acc, 0.0f) : acc;
+    }
+}
+
+void Model::setCondition(const float* values) {
+    bool changed = !conditioned;
+    for (auto i = 0; i < conditionSize; i++)
+        changed = changed || values[i] != condition[i];
+    if (!changed)
+        return;
+
+    // the pipeline's workers read the scales, its stages take new ones between blocks. while
+    // they still work through the last change this one waits for the next block
+    auto* scales = &film;
+    if (pipeline != nullptr && (scales = pipeline->beginOutputScales()) == nullptr)
+        return;
+    std::copy(values, values + conditionSize, condition.begin());
+    conditioned = true;
+    unmerge();
+
+    // the generator MLP, every layer followed by a ReLU
+    const float* x = condition.data();
+    int n = conditionSize;
+    for (auto l = 0; l < (int) generatorWeights->size(); l++) {
+        float* y = conditionHidden[l % 2].data();
+        applyLinear((*generatorWeights)[l], x, n, y, true);
+        n = (int) (*generatorWeights)[l].size() / (n + 1);
+        x = y;
+    }
+
+    // each layer's gains and biases
+    for (auto i = 0; i < getLayers(); i++) {
+        float* gains = (*scales)[i].data();
+        applyLinear((*adptWeights)[i], x, n, gains, false);
+        for (auto o = 0; o < kernels[i].getOutputs(); o++)
+            gains[o] += 1.0f;
+        if (pipeline == nullptr)
+            setOutputScale(i, gains);
+    }
+    if (pipeline != nullptr)
+        pipeline->endOutputScales();
+}
+
+// film values {gains, biases} of layer i become its kernel's output scale, none when they change nothing
+void Model::setOutputScale(int layer, const float* values) {
+    int out = kernels[layer].getOutputs();
+    if (values != film[layer].data())
+        std::copy(values, values + 2 * out, film[layer].begin());
+
+    bool identity = true;
+    for (auto o = 0; o < out; o++)
+        identity = identity && values[o] == 1.0f && values[out + o] == 0.0f;
+    const float* gains = film[layer].data();
+    kernels[layer].setOutputScale(identity ? nullptr : gains, identity ? nullptr : gains + out);
+}
+
+bool Model::setMorphTarget(Model& target) {
+    morphing = false;
+    morphAmount = 0.0f;
+    morphSpherical = false;
+    bool same = target.getLayers() == getLayers();
+    for (auto i = 0; i < getLayers() && same; i++)
+        same = kernels[i].setMorphTarget(target.kernels[i]);
+    if (!same) {
+        for (auto& kernel : kernels)
+            kernel.clearMorph();
+        return false;
+    }
+    morphCoefficients.assign(2 * getLayers(), 0.0f);
+    return true;
+}
+
+void Model::setMorph(float amount, bool spherical) {
+    if (getLayers() == 0 || !kernels[0].hasMorphTarget())
+        return;
+    if (!morphing) {
+        if (amount == morphAmount && spherical == morphSpherical)
+            return;
+        if (pipeline != nullptr && pipeline->isHandingOff())
+            return;
+        beginMorph(amount, spherical);
+    }
+    stepMorph(morphBudget);
+}
+
+void Model::finishMorph() {
+    if (morphing)
+        stepMorph(std::numeric_limits<int>::max());
+}
+
+// slerp per layer, the angle between the two ends of a layer fixes the coefficients
+// for all of its weights. layers with (nearly) parallel ends are interpolated linearly
+void Model::beginMorph(float amount, bool spherical) {
+    passAmount = amount;
+    passSpherical = spherical;
+    for (auto i = 0; i < getLayers(); i++) {
+        const auto& k = kernels[i];
+        double a = 1.0 - amount, b = amount;
+        if (spherical && k.morphNorms[0] > 0.0 && k.morphNorms[1] > 0.0) {
+            double omega = std::acos(std::max(-1.0, std::min(1.0, k.morphDot / (k.morphNorms[0] * k.morphNorms[1]))));
+            if (std::sin(omega) > 1e-6) {
+                a = std::sin((1.0 - amount) * omega) / std::sin(omega);
+                b = std::sin(amount * omega) / std::sin(omega);
+            }
+        }
+        morphCoefficients[2 * i] = (float) a;
+        morphCoefficients[2 * i + 1] = (float) b;
+    }
+    morphLayer = morphOffset = 0;
+    morphing = true;
+}
+
+void Model::stepMorph(int budget) {
+    while (budget > 0 && morphLayer < getLayers()) {
+        auto& kernel = kernels[morphLayer];
+        int n = std::min(budget, kernel.getMorphSize() - morphOffset);
+        kernel.morph(morphCoefficients[2 * morphLayer], morphCoefficients[2 * morphLayer + 1], morphOffset, n);
+        budget -= n;
+        morphOffset += n;
+        if (morphOffset == kernel.getMorphSize()) {
+            morphLayer++;
+            morphOffset = 0;
+        }
+    }
+
+    // all layers switch to the new weights together, the pipeline's stages do that between two blocks
+    if (morphLayer == getLayers()) {
+        if (pipeline != nullptr) {
+            if (!pipeline->swapMorph())
+                return;
+        } else {
+            unmerge();
+            for (auto& kernel : kernels)
+                kernel.swapMorph();
+        }
+        morphAmount = passAmount;
+        morphSpherical = passSpherical;
+        morphing = false;
+    }
+}
+
+Conv1dKernel::Precision Model::setPrecision(Conv1dKernel::Precision newPrecision) {
+    unmerge();
+    for (auto& kernel : kernels)
+        kernel.setPrecision(Conv1dKernel::Float32);
+
+    precision = Conv1dKernel::Float32;
+    for (auto i = 1; i + 1 < getLayers(); i++)
+        precision = kernels[i].setPrecision(newPrecision);
+    if (!buffers.empty())
+        allocateScratch();
+    return precision;
+}
+
+float Model::prune(float threshold, float keep) {
+    unmerge();
+    long zeros = 0, total = 0;
+    for (auto i = 1; i + 1 < getLayers(); i++) {
+        auto& kernel = kernels[i];
+        kernel.prune(threshold, keep);
+        long weights = (long) kernel.getOutputs() * (kernel.getInputs() / kernel.groups) * kernel.kernelWidth;
+        if (kernel.separable)
+            weights = (long) kernel.getOutputs() * kernel.getInputs() + (long) kernel.getInputs() * kernel.kernelWidth;
+        long nonzero = (long) std::count_if(kernel.packedWeights.begin(), kernel.packedWeights.end(),
+                                            [](float w) {return w != 0.0f;});
+        zeros += weights - nonzero;
+        total += weights;
+    }
+    return total > 0 ? (float) zeros / total : 0.0f;
+}
+
+void Model::setGains(float inputGain, float outputGain) {
+    if (inputGain == networkGains[0] && outputGain == networkGains[1])
+        return;
+    networkGains[0] = inputGain;
+    networkGains[1] = outputGain;
+    applyGains();
+}
+
+// fold the gains into the kernels at the ends of the network, where a kernel can't take
+// one (a residual connection, or the torch backend which doesn't read the packed weights)
+// it is applied to the frames. so are all of them while the pipeline's workers read the
+// kernels, preparePipeline leaves those at unit gain
+void Model::applyGains() {
+    if (pipeline != nullptr) {
+        frameGains[0] = networkGains[0];
+        frameGains[1] = networkGains[1];
+        return;
+    }
+
+    bool folded[2] = {false, false};
+    int n = (int) kernels.size();
+    if (merged)
+        folded[0] = folded[1] = mergedKernel.setGains(networkGains[0], networkGains[1]);
+    else if (getBackend() == Native && n == 1)
+        folded[0] = folded[1] = kernels[0].setGains(networkGains[0], networkGains[1]);
+    else if (getBackend() == Native && n > 1) {
+        folded[0] = kernels.front().setGains(networkGains[0], 1.0f);
+        folded[1] = kernels.back().setGains(1.0f, networkGains[1]);
+    }
+    else {
+        for (auto& kernel : kernels)
+            kernel.setGains(1.0f, 1.0f);
+    }
+    for (auto i = 0; i < 2; i++)
+        frameGains[i] = folded[i] ? 1.0f : networkGains[i];
+}
+
+// the layers of the stack are applied to the impulse response of each input channel,
+// and to silence for the bias. the result is a single convolution over the receptive field
+bool Model::optimise() {
+    torch::NoGradGuard no_grad;
+    if (merged)
+        return true;
+    if (getActivation() != Linear || getResidual() || getBackend() != Native || precision != Conv1dKernel::Float32
+        || pipeline != nullptr || getLayers() == 0 || buffers.empty())
+        return false;
+
+    // multiplies per frame, tiles padded, against those of the merged kernel
+    int context = 0;
+    size_t layered = 0;
+    for (auto& kernel : kernels) {
+        context += kernel.getContext();
+        layered += kernel.isSparse() ? kernel.sparseWeights.size() : kernel.packedWeights.size();
+    }
+    size_t cost = (size_t) ((getOutputs() + 3) / 4) * 4 * getInputs() * (context + 1);
+    if (cost >= layered)
+        return false;
+
+    // the layers at unit gain, the merged kernel takes the gains
+    for (auto& kernel : kernels)
+        kernel.setGains(1.0f, 1.0f);
+
+    int n = getInputs();
+    auto x = torch::zeros({n + 1, n, 2 * context + 1});
+    for (auto c = 0; c < n; c++)
+        x[c][c][context].fill_(1.0f);
+    for (auto i = 0; i < getLayers(); i++)
+        x = applyLayer(i, x);
+
+    // output frame t sees the impulse through tap context - t
+    auto response = (x.narrow(0, 0, n) - x.narrow(0, n, 1)).flip({2});
+    auto weight = response.permute({1, 0, 2}).contiguous();
+    auto b = x[n].select(1, 0).contiguous();
+
+    mergedKernel.setup(n, getOutputs(), context + 1, 1, 1, true);
+    mergedKernel.setISA(kernels[0].getISA());
+    mergedKernel.setActivation(activations::Linear);
+    mergedKernel.packWeights(weight.data_ptr<float>(), b.data_ptr<float>());
+
+    int widest = getOutputs();
+    for (auto& kernel : kernels)
+        widest = std::max(widest, kernel.getOutputs());
+    mergedBuffer.assign(lanes * n * getHistoryStride(context), 0.0f);
+    for (auto& scratch : unmergeScratch)
+        scratch.assign(widest * context, 0.0f);
+    merged = true;
+    applyGains();
+    resetState();
+    return true;
+}
+
+// back to the layers, each layer's history comes from running the layers before it over the
+// merged input history, so the output carries on without a click. doesn't allocate
+void Model::unmerge() {
+    if (!merged)
+        return;
+    merged = false;
+    applyGains();
+
+    int context = mergedKernel.getContext();
+    int stride = getHistoryStride(context);
+    for (auto lane = 0; lane < lanes; lane++) {
+        const float* x = mergedBuffer.data() + lane * getInputs() * stride + mergedOffsets[lane];
+        int xStride = stride, frames = context;
+        for (auto i = 0; i < getLayers(); i++) {
+            int layerContext = kernels[i].getContext();
+            for (auto c = 0; c < kernels[i].getInputs(); c++)
+                std::memcpy(getLayerInputPointer(i, c, lane) - layerContext, x + c * xStride + frames - layerContext,
+                            layerContext * sizeof(float));
+            if (i + 1 == getLayers() || frames == layerContext)
+                break;
+
+            float* y = unmergeScratch[i % 2].data();
+            kernels[i].process(x, xStride, y, context, frames - layerContext, kernelScratch[lane * getLayers() + i].data());
+            x = y;
+            xStride = context;
+            frames -= layerContext;
+        }
+
+        // the frames of a fixed block that is still filling up
+        const float* pending = mergedBuffer.data() + lane * getInputs() * stride + mergedOffsets[lane] + context;
+        for (auto c = 0; c < getInputs() && blockFill > 0; c++)
+            std::memcpy(getLayerInputPointer(0, c, lane), pending + c * stride, blockFill * sizeof(float));
+    }
+}
+
+// all lanes a layer at a time, so the kernels can run them together, the torch backend
+// and the merged network go lane by lane
+void Model::processLanes(int numSamples, float* const* outputs) {
+    if (lanes == 1 || merged || getBackend() != Native) {
+        for (auto lane = 0; lane < lanes; lane++)
+            processLane(numSamples, outputs + lane * getOutputs(), lane);
+        return;
+    }
+
+    for (auto i = 0; i < getLayers(); i++) {
+        int stride = getHistoryStride(kernels[i].getContext());
+        for (auto lane = 0; lane < lanes; lane++) {
+            laneInputs[lane] = bufferData[i] + lane * kernels[i].getInputs() * stride + historyOffsets[lane * getLayers() + i];
+            laneOutputs[lane] = (i + 1 == getLayers()) ? outputs + lane * getOutputs() : layerOutputs[lane][i].data();
+            laneScratch[lane] = kernelScratch.empty() ? nullptr : kernelScratch[lane * getLayers() + i].data();
+            if (i + 1 < getLayers()) {
+                auto& rows = layerOutputs[lane][i];
+                for (auto c = 0; c < (int) rows.size(); c++)
+                    rows[c] = getLayerInputPointer(i + 1, c, lane);
+            }
+        }
+        kernels[i].processLanes(lanes, laneInputs.data(), stride, laneOutputs.data(), numSamples, laneScratch.data());
+    }
+
+    for (auto lane = 0; lane < lanes; lane++) {
+        for (auto i = 0; i < getLayers(); i++) {
+            int inChannels = kernels[i].getInputs();
+            float* rows = bufferData[i] + lane * inChannels * getHistoryStride(kernels[i].getContext());
+            advanceHistory(rows, inChannels, kernels[i].getContext(), historyOffsets[lane * getLayers() + i], numSamples);
+        }
+    }
+}
+
+void Model::processLane(int numSamples, float* const* outputs, int lane) {
+    if (!merged) {
+        processLayers(0, getLayers(), numSamples, outputs, lane);
+        return;
+    }
+
+    int context = mergedKernel.getContext();
+    int stride = getHistoryStride(context);
+    float* rows = mergedBuffer.data() + lane * getInputs() * stride;
+    mergedKernel.process(rows + mergedOffsets[lane], stride, outputs, numSamples);
+    advanceHistory(rows, getInputs(), context, mergedOffsets[lane], numSamples);
+}
+
+// every lane and layer converts its input into its own scratch, so the pipeline's
+// stages never share one
+void Model::allocateScratch() {
+    kernelScratch.clear();
+    for (auto lane = 0; lane < lanes; lane++) {
+        for (auto i = 0; i < getLayers(); i++)
+            kernelScratch.push_back(std::vector<char>(kernels[i].getScratchSize(maxBlock)));
+    }
 }
 
 int Model::getOutputSize(int frameSize){
@@ -163,16 +1123,34 @@ int Model::getOutputSize(int frameSize){
     return outputSize;
 }
 
+int Model::getDilation(int layer){
+    return pow(getDilationFactor(), layer);
+}
+
+int Model::getReceptiveField(){
+    int rf = 1;
+    for (auto i = 0; i < getLayers(); i++) {
+        rf = rf + ((getKernelWidth()-1) * getDilation(i));
+    }
+    return rf;
+}
+
 int Model::getNumParameters(){
     int n = 0;
-    for (const auto& p : parameters()) {
-        auto sizes = p.sizes();
-        int s = 1;
-        for (auto dim : sizes) {
-            std::cout << dim << std::endl;
-            s = s * dim;
-        }
-        n = n + s;
-    }
+    for (const auto& p : parameters())
+        n = n + (int) p.numel();
     return n;
+}
+
+// a multiply and an add per weight of every layer, for one frame of every output
+long Model::getNumFlops(){
+    long flops = 0;
+    for (const auto& kernel : kernels) {
+        long taps = (long) kernel.getInputs() * kernel.kernelWidth;
+        if (kernel.separable)
+            flops += 2 * (taps + (long) kernel.getOutputs() * kernel.getInputs());
+        else
+            flops += 2 * taps / kernel.groups * kernel.getOutputs();
+    }
+    return flops;
 }
\ No newline at end of file
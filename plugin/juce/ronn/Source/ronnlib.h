@@ -2,6 +2,11 @@
 #define RONNLIB_H
 
 #include <torch/torch.h>
+#include "conv1d.h"
+#include "oversampling.h"
+#include "snapshot.h"
+
+struct ModelPipeline;
 
 struct Model : public torch::nn::Module {
 
@@ -9,6 +14,7 @@ struct Model : public torch::nn::Module {
 
         enum Activation {Linear, LeakyReLU, Tanh, Sigmoid, ReLU, ELU, SELU, GELU, RReLU, Softplus, Softshrink, Sine, Sine30};
         enum InitType   {normal, uniform1, uniform2, xavier_normal, xavier_uniform, kaiming_normal, kamming_uniform};
+        enum Backend    {Torch, Native};
 
         Model(int nInputs, 
               int nOutputs, 
@@ -20,41 +26,242 @@ struct Model : public torch::nn::Module {
               int act,
               int init,
               int seed,
-              bool dwise);
+              bool dwise,
+              bool res = false,
+              const WeightSnapshot* weights = nullptr);
+        ~Model();
+
+        // a model of its own on the weights of source: the libtorch modules and the FiLM
+        // weights are shared, the packed kernels copied, as every model rewrites those with
+        // its own gains, conditioning and morph. it keeps source alive, and comes without
+        // streaming state like a new model. initModel and loadWeights must not be called on
+        // either after this, reinitialise copies the weights first
+        static std::unique_ptr<Model> share(const std::shared_ptr<Model>& source);
 
         torch::Tensor forward(torch::Tensor);
         void initModel(int seed);
-        void buildModel(int seed);
+
+        // new weights from seed and init for a change that keeps the shapes, drawn into the
+        // tensors and packed kernels the model has. the streaming buffers stay, the state is
+        // cleared and a pipeline has to be prepared again. a shared model copies its weights
+        // first. not while processing
+        void reinitialise(int seed, InitType init);
+
+        // streaming inference, each layer keeps (kWidth-1) * dilation^i past input frames
+        // so that only the new output frames are computed for every incoming block.
+        // lanes are independent streams (e.g. the channels of a dual mono input)
+        // running through the same weights, each with its own history. each layer
+        // runs all lanes together (Conv1dKernel::processLanes).
+        // with fixedBlock, frames are collected until a block of maxBlockSize is
+        // complete and the network runs once per block, which costs a block of latency
+        // but keeps the per call overhead of small host blocks out of the network.
+        // with oversampling (2, 4 or 8) the network runs at that multiple of the rate
+        // the caller streams at, maxBlockSize stays in frames of the caller's rate
+        void prepareStreaming(int maxBlockSize, int numLanes = 1, bool fixedBlock = false, int oversampling = 1);
+        void resetState();
+        torch::Tensor forwardStreaming(torch::Tensor);
+
+        // allocation free streaming: write up to getMaxFrames() new frames to getInputPointer()
+        // for each input, then process() writes the same number of frames to each of the
+        // getOutputs() output pointers of every lane, one lane after the other
+        // (nullptr outputs are computed but discarded)
+        float* getInputPointer(int channel, int lane = 0);
+        void process(int numSamples, float* const* outputs);
+        int getMaxFrames();
+        int getMaxBlockSize(){return maxBlock;};     // in network frames
+        int getLanes(){return lanes;};
+        bool isFixedBlock(){return fixedBlock;};
+        int getOversampling(){return oversampler != nullptr ? oversampler->getFactor() : 1;};
+
+        // layers [first, last) of one lane, reading the new frames from
+        // getLayerInputPointer(first, ...), used by the pipeline stages
+        void processLayers(int first, int last, int numSamples, float* const* outputs, int lane);
+        float* getLayerInputPointer(int layer, int channel, int lane);
+        int getLayerInputs(int layer){return kernels[layer].getInputs();};
+
+        // multicore streaming: when a block takes too long for one core at this
+        // sample rate, the layers are split into stages on up to maxThreads worker
+        // threads, which delays the output by getLatencySamples()
+        void preparePipeline(double sampleRate, int maxThreads);
+        std::vector<double> measureLayerCosts();
+        int getLatencySamples();
+
+        // FiLM global conditioning as in dev/ronn/condition.py: an MLP turns the
+        // getConditionSize() values into a 128 dim embedding, which each layer projects
+        // to a gain g and bias b per output channel, y = (1 + g) * conv(x) + b ahead of
+        // the activation. Both only run when the values change, the result becomes the
+        // kernels' output scale, so this is allocation free and costs nothing per frame.
+        // with a pipeline each stage picks the scales of its layers up between two blocks,
+        // all from the same block on. all zero values leave the network unchanged
+        void setCondition(const float* values);
+        int getConditionSize(){return conditionSize;};
+        void setOutputScale(int layer, const float* values);    // film values {gains, biases} of a layer
+
+        // weight morphing between this model's weights and those of another model of the
+        // same shape, e.g. another seed. setMorph interpolates the packed weights of each
+        // layer linearly or spherically (which keeps the scale of two random initialisations
+        // in between), morphBudget weights per call into a second set that replaces the
+        // current one once complete. that is allocation free, so the amount can be automated
+        // at any rate, it is picked up again whenever a pass finishes. new weights end the
+        // morph, and it only applies to the native backend. with a pipeline the stages swap
+        // the new weights in between two blocks, like the FiLM values
+        bool setMorphTarget(Model& target);
+        void setMorph(float amount, bool spherical = false);
+        void finishMorph();
+        float getMorph(){return morphAmount;};
+        bool isMorphing(){return morphing;};
+        static const int morphBudget = 1 << 14;
+
+        // reduced precision for the hidden layers of the native backend, the first and last
+        // layer stay in float. Int8 takes the range of each layer's input from the block it
+        // gets, so gains, conditioning and morphs need nothing else. returns the precision the
+        // kernels support, Float32 where they have no quantised loops. like prepareStreaming it
+        // must not be called while processing
+        Conv1dKernel::Precision setPrecision(Conv1dKernel::Precision newPrecision);
+        Conv1dKernel::Precision getPrecision(){return precision;};
+
+        // prunes the hidden layers to at most the largest keep fraction of their weights above
+        // threshold, returns the fraction of hidden weights that are zero. not while processing
+        float prune(float threshold, float keep = 1.0f);
+
+        // gains on the inputs and outputs, folded into the first and last layer when possible
+        void setGains(float inputGain, float outputGain);
+
+        // merges a linear network into a single convolution when that is cheaper, run once it is
+        // set up for streaming. returns whether it was merged
+        bool optimise();
+        bool isMerged(){return merged;};
+
+        // weight snapshots hold the exact weights of a model. a model built with one
+        // whose hyperparameters (seed included) match takes its weights from there
+        // instead of running initModel, otherwise it is initialised from the seed
+        void buildModel(int seed, const WeightSnapshot* weights = nullptr);
+        bool loadWeights(const WeightSnapshot& snapshot);
+        void saveWeights(std::vector<char>& data);
+        WeightSnapshot::Hyperparameters getHyperparameters();
+
         int getOutputSize(int frameSize);
+        // weights and biases of the network and the FiLM generator, and the floating point
+        // operations of the convolutions per frame, which depthwise layers cut to the
+        // depthwise taps plus a 1x1 mix of the channels
         int getNumParameters();
+        long getNumFlops();
+        int getReceptiveField();
+        int getDilation(int layer);
 
         void setBias(bool newBias){bias = newBias;};
         void setInputs(int newInputs){inputs = newInputs;};
         void setLayers(int newLayers){layers = newLayers;};
         void setOutputs(int newOutputs){outputs = newOutputs;};
         void setChannels(int newChannels){channels = newChannels;};
-        void setActivation(Activation newActivation){activation = newActivation;};
+        void setActivation(Activation newActivation);
+        void setResidual(bool newResidual);
         void setInitType(InitType newInitType){initType = newInitType;};
         void setKernelWidth(int newKernelWidth){kernelWidth = newKernelWidth;};
         void setDilationFactor(int newDilationFactor){dilationFactor = newDilationFactor;};
+        void setBackend(Backend newBackend){backend = newBackend; applyGains();};
 
         bool getBias(){return bias;};
+        bool getResidual(){return residual;};
         int getInputs(){return inputs;};
         int getLayers(){return layers;};
         int getOutputs(){return outputs;};
         int getChannels(){return channels;};
         int getKernelWidth(){return kernelWidth;};
         int getDilationFactor(){return dilationFactor;};
+        int getSeed(){return seed;};
         Activation getActivation(){return activation;};
         InitType getInitType(){return initType;}
+        Backend getBackend(){return backend;};
 
     private:
-        int inputs, outputs, layers, channels, kernelWidth, dilationFactor;
-        bool bias, depthwise;
+        Model();
+        void registerModules(bool replace);
+        void unshare();
+        torch::Tensor applyLayer(int layer, torch::Tensor x);
+        torch::Tensor convolve(int layer, torch::Tensor x);
+        float* getNetworkInputPointer(int channel, int lane);
+        void processNetwork(int numSamples, float* const* outputs);
+        void packWeights();
+        void beginMorph(float amount, bool spherical);
+        void stepMorph(int budget);
+        void allocateScratch();
+        void applyGains();
+        void unmerge();
+        void processLanes(int numSamples, float* const* outputs);
+        void processLane(int numSamples, float* const* outputs, int lane);
+        int getHistoryStride(int context){return 2 * context + maxBlock;};
+        void advanceHistory(float* rows, int channels, int context, int& offset, int numSamples);
+
+        int inputs, outputs, layers, channels, kernelWidth, dilationFactor, seed;
+        bool bias, depthwise, residual;
         Activation activation;
         InitType initType;
+        Backend backend = Native;
         std::vector<torch::nn::Conv1d> conv;      
+        std::vector<torch::nn::Conv1d> pointwise; // after the depthwise hidden layers, empty modules for the others
+        std::shared_ptr<Model> weightsOwner;      // the model whose modules these are, when shared
+        std::vector<Conv1dKernel> kernels;    // packed copies of the conv weights for the native backend
+
+        // FiLM generator and per layer projections, with plain copies {out, in + 1} of their
+        // weights and biases for setCondition, and the gains and biases {2, outChannels} of each layer
+        int conditionSize = 2, conditionDim = 128;
+        std::vector<torch::nn::Linear> generator, adpt;
+        std::shared_ptr<std::vector<std::vector<float>>> generatorWeights, adptWeights;
+        std::vector<float> condition, conditionHidden[2];
+        std::vector<std::vector<float>> film;
+        bool conditioned = false;
+
+        // morph amount of the current weights, and the pass computing the next ones,
+        // {a, b} per layer with weights a * own + b * target
+        float morphAmount = 0.0f, passAmount = 0.0f;
+        bool morphSpherical = false, passSpherical = false, morphing = false;
+        int morphLayer = 0, morphOffset = 0;
+        std::vector<float> morphCoefficients;
+
+        Conv1dKernel::Precision precision = Conv1dKernel::Float32;
+
+        // gains around the network, and what is left of them to apply to the frames
+        float networkGains[2] = {1.0f, 1.0f}, frameGains[2] = {1.0f, 1.0f};
+
+        // the merged network, its input history {lanes, inputs, 2 * context + maxBlock} with the
+        // window of each lane at mergedOffsets[lane], and the scratch for rebuilding the layer
+        // histories from it. all of it stays allocated after unmerge(), which can happen on the
+        // audio thread
+        bool merged = false;
+        Conv1dKernel mergedKernel;
+        std::vector<float> mergedBuffer, unmergeScratch[2];
+        std::vector<int> mergedOffsets;
+
+        // streaming state, the input of each layer as {lanes, inChannels, 2 * context + maxBlock}
+        // holding a window of the past frames followed by the frames of the current block, which
+        // starts historyOffsets[lane * layers + layer] frames into the rows (see advanceHistory)
+        int maxBlock = 0, lanes = 1;
+        std::vector<torch::Tensor> buffers;
+        std::vector<float*> bufferData;
+        std::vector<int> historyOffsets;
+        std::vector<std::vector<std::vector<float*>>> layerOutputs;  // [lane][layer], rows the layer writes to
+        std::vector<std::vector<char>> kernelScratch;                // [lane * layers + layer], converted inputs of quantised layers
+        std::vector<const float*> laneInputs;                        // [lane], a layer's arguments for processLanes
+        std::vector<float* const*> laneOutputs;
+        std::vector<void*> laneScratch;
+
+        // fixed block mode, the output of the last full block {lanes, outputs, maxBlock}
+        // is handed out while the next one is collected
+        bool fixedBlock = false;
+        int blockFill = 0;
+        std::vector<float> blockOutputs;
+        std::vector<float*> blockOutputRows;
+
+        // oversampling, the caller's frames {lanes, inputs, maxBlock / factor} are
+        // upsampled into the network, its {lanes, outputs, maxBlock} outputs downsampled
+        std::unique_ptr<Oversampler> oversampler;
+        std::vector<float> oversampledInputs, oversampledOutputs;
+        std::vector<float*> oversampledRows;
         torch::nn::LeakyReLU leakyrelu;
+
+        // declared last, its worker threads stop before the buffers go away
+        std::unique_ptr<ModelPipeline> pipeline;
 };
 
 #endif
\ No newline at end of file
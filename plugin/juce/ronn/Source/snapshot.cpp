@@ -0,0 +1,154 @@
+#include <cstring>
+#include <fstream>
+
+#include "snapshot.h"
+
+#if defined(_WIN32)
+ #define NOMINMAX
+ #include <windows.h>
+#else
+ #include <fcntl.h>
+ #include <sys/mman.h>
+ #include <sys/stat.h>
+ #include <unistd.h>
+#endif
+
+static size_t alignUp(size_t n) {
+    return (n + WeightSnapshot::alignment - 1) / WeightSnapshot::alignment * WeightSnapshot::alignment;
+}
+
+bool WeightSnapshot::Hyperparameters::operator== (const Hyperparameters& other) const {
+    return std::memcmp(this, &other, sizeof(Hyperparameters)) == 0;
+}
+
+//==============================================================================
+WeightSnapshot::WeightSnapshot(const void* data, size_t size) {
+    // the copy starts on an aligned address, so the tensors are aligned too
+    copy.resize(size + alignment);
+    char* start = copy.data() + (alignment - (uintptr_t) copy.data() % alignment) % alignment;
+    std::memcpy(start, data, size);
+    check(start, size);
+}
+
+WeightSnapshot::WeightSnapshot(const std::string& path) {
+#if defined(_WIN32)
+    HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE)
+        return;
+    LARGE_INTEGER size;
+    HANDLE fileMapping = nullptr;
+    if (GetFileSizeEx(file, &size) && size.QuadPart > 0)
+        fileMapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (fileMapping != nullptr) {
+        mapping = MapViewOfFile(fileMapping, FILE_MAP_READ, 0, 0, 0);
+        mappingSize = (size_t) size.QuadPart;
+        CloseHandle(fileMapping);       // the view keeps the mapping alive
+    }
+    CloseHandle(file);
+#else
+    int file = open(path.c_str(), O_RDONLY);
+    if (file < 0)
+        return;
+    struct stat info;
+    if (fstat(file, &info) == 0 && info.st_size > 0) {
+        mapping = mmap(nullptr, (size_t) info.st_size, PROT_READ, MAP_PRIVATE, file, 0);
+        mappingSize = (size_t) info.st_size;
+        if (mapping == MAP_FAILED)
+            mapping = nullptr;
+    }
+    close(file);
+#endif
+
+    if (mapping != nullptr)
+        check((const char*) mapping, mappingSize);
+}
+
+WeightSnapshot::~WeightSnapshot() {
+    if (mapping == nullptr)
+        return;
+#if defined(_WIN32)
+    UnmapViewOfFile(mapping);
+#else
+    munmap(mapping, mappingSize);
+#endif
+}
+
+// the header and table have to describe tensors that lie within the data
+bool WeightSnapshot::check(const char* data, size_t size) {
+    const Header* h = (const Header*) data;
+    if (size < sizeof(Header) || h->magic != magic || h->byteOrder != byteOrderMark
+        || h->version == 0 || h->version > currentVersion || h->size > size)
+        return false;
+
+    size_t tableEnd = sizeof(Header) + (size_t) h->numTensors * sizeof(TableEntry);
+    if (tableEnd > h->size)
+        return false;
+
+    const TableEntry* table = (const TableEntry*) (data + sizeof(Header));
+    for (uint32_t i = 0; i < h->numTensors; i++) {
+        if (table[i].offset % alignment != 0 || table[i].offset < tableEnd
+            || table[i].numElements > (h->size - table[i].offset) / sizeof(float))
+            return false;
+    }
+
+    if (checksum(data + sizeof(Header), h->size - sizeof(Header)) != h->checksum)
+        return false;
+    header = h;
+    return true;
+}
+
+uint32_t WeightSnapshot::checksum(const char* data, size_t size) {
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < size; i++)
+        hash = (hash ^ (uint8_t) data[i]) * 16777619u;
+    return hash;
+}
+
+const float* WeightSnapshot::getTensor(int index) const {
+    const TableEntry* table = (const TableEntry*) (header + 1);
+    return (const float*) ((const char*) header + table[index].offset);
+}
+
+size_t WeightSnapshot::getTensorSize(int index) const {
+    const TableEntry* table = (const TableEntry*) (header + 1);
+    return (size_t) table[index].numElements;
+}
+
+//==============================================================================
+void WeightSnapshot::write(const Hyperparameters& model,
+                           const std::vector<const float*>& tensors,
+                           const std::vector<size_t>& numElements,
+                           std::vector<char>& data) {
+    size_t numTensors = tensors.size();
+    std::vector<TableEntry> table(numTensors);
+    size_t size = alignUp(sizeof(Header) + numTensors * sizeof(TableEntry));
+    for (size_t i = 0; i < numTensors; i++) {
+        table[i].offset = size;
+        table[i].numElements = numElements[i];
+        size = alignUp(size + numElements[i] * sizeof(float));
+    }
+
+    // the padding is zeroed so equal weights always give the same bytes
+    data.assign(size, 0);
+    Header h;
+    std::memset(&h, 0, sizeof(Header));
+    h.magic = magic;
+    h.byteOrder = byteOrderMark;
+    h.version = currentVersion;
+    h.numTensors = (uint32_t) numTensors;
+    h.size = size;
+    h.model = model;
+
+    std::memcpy(data.data() + sizeof(Header), table.data(), numTensors * sizeof(TableEntry));
+    for (size_t i = 0; i < numTensors; i++)
+        std::memcpy(data.data() + table[i].offset, tensors[i], numElements[i] * sizeof(float));
+
+    h.checksum = checksum(data.data() + sizeof(Header), size - sizeof(Header));
+    std::memcpy(data.data(), &h, sizeof(Header));
+}
+
+bool WeightSnapshot::writeFile(const std::string& path, const std::vector<char>& data) {
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    file.write(data.data(), (std::streamsize) data.size());
+    return (bool) file;
+}
@@ -0,0 +1,91 @@
+#ifndef SNAPSHOT_H
+#define SNAPSHOT_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Binary snapshot of the exact weights of a Model, so a model can be
+// rebuilt without running the initialisation again and comes out the same
+// no matter what a libtorch upgrade does to its random number generator.
+//
+//   header      the Header below, 128 bytes
+//   table       numTensors entries of {offset, numElements}
+//   tensors     float32, each starting on a 64 byte boundary
+//
+// in the order of Model::parameters(). All offsets are from the start of the
+// snapshot and everything is stored in the machine's byte order (checked on
+// load), so a snapshot is used in place, straight from memory or from a file
+// mapped with mmap, without parsing anything but the fixed size header.
+struct WeightSnapshot {
+
+    public:
+
+        static const uint32_t magic = 0x574e4e52;       // "RNNW"
+        static const uint32_t byteOrderMark = 0x01020304;
+        static const uint32_t currentVersion = 1;
+        static const size_t alignment = 64;
+
+        // everything the shapes and values of the weights depend on
+        struct Hyperparameters {
+            int32_t inputs, outputs, layers, channels, kernelWidth, dilationFactor;
+            int32_t activation, initType, seed;
+            int32_t bias, depthwise, residual;
+
+            bool operator== (const Hyperparameters& other) const;
+            bool operator!= (const Hyperparameters& other) const {return !(*this == other);};
+        };
+
+        struct Header {
+            uint32_t magic, byteOrder, version, numTensors;
+            uint64_t size;                      // of the whole snapshot in bytes
+            uint32_t checksum;                  // FNV-1a of everything after the header
+            uint32_t reserved0;
+            Hyperparameters model;
+            uint8_t reserved[128 - 32 - sizeof(Hyperparameters)];
+        };
+
+        struct TableEntry {
+            uint64_t offset, numElements;
+        };
+
+        // checks and copies a snapshot held in memory, e.g. from a plugin state
+        WeightSnapshot(const void* data, size_t size);
+        // maps a snapshot file read only, nothing is copied
+        explicit WeightSnapshot(const std::string& path);
+        ~WeightSnapshot();
+
+        WeightSnapshot(const WeightSnapshot&) = delete;
+        WeightSnapshot& operator= (const WeightSnapshot&) = delete;
+
+        // false when the data is not a snapshot, is damaged or from a newer version
+        bool isValid() const {return header != nullptr;};
+        const Header& getHeader() const {return *header;};
+        const void* getData() const {return header;};
+        size_t getSize() const {return header != nullptr ? header->size : 0;};
+
+        int getNumTensors() const {return (int) header->numTensors;};
+        const float* getTensor(int index) const;
+        size_t getTensorSize(int index) const;
+
+        // writes the snapshot of tensors with the given sizes into data, which is resized to fit
+        static void write(const Hyperparameters& model,
+                          const std::vector<const float*>& tensors,
+                          const std::vector<size_t>& numElements,
+                          std::vector<char>& data);
+        static bool writeFile(const std::string& path, const std::vector<char>& data);
+
+    private:
+        bool check(const char* data, size_t size);
+        static uint32_t checksum(const char* data, size_t size);
+
+        const Header* header = nullptr;
+        std::vector<char> copy;                 // for snapshots from memory, over allocated to align it
+        void* mapping = nullptr;                // for mapped files
+        size_t mappingSize = 0;
+};
+
+static_assert(sizeof(WeightSnapshot::Header) == 128, "the snapshot header has a fixed size");
+
+#endif
@@ -0,0 +1,275 @@
+#include<iostream>
+#include<vector>
+#include<atomic>
+#include<cstdlib>
+#include<cerrno>
+#include<new>
+#include<cmath>
+#include<algorithm>
+#include<memory>
+#include<torch/torch.h>
+
+#include "ronnlib.h"
+
+// Checks that once a model is prepared, the calls processBlock makes never allocate:
+// the condition, gains and morph changing every block, the old model crossfaded
+// into the new one, host blocks of any length split at getMaxFrames(), per channel
+// lanes, fixed blocks, oversampling, Int8, eco and the multicore pipeline.
+// operator new misses what libtorch (c10) allocates with malloc and posix_memalign,
+// so with glibc the C allocator is hooked as well, on every thread.
+
+static std::atomic<bool> armed(false);
+static std::atomic<long> allocations(0);
+
+static inline void countAllocation() {
+    if (armed.load(std::memory_order_relaxed))
+        allocations++;
+}
+
+#if defined(__GLIBC__)
+// glibc resolves the C allocator of every library to these, which forward to its own
+extern "C" {
+    void* __libc_malloc(size_t size);
+    void* __libc_calloc(size_t count, size_t size);
+    void* __libc_realloc(void* p, size_t size);
+    void* __libc_memalign(size_t alignment, size_t size);
+    void  __libc_free(void* p);
+
+    void* malloc(size_t size) {
+        countAllocation();
+        return __libc_malloc(size);
+    }
+
+    void* calloc(size_t count, size_t size) {
+        countAllocation();
+        return __libc_calloc(count, size);
+    }
+
+    void* realloc(void* p, size_t size) {
+        countAllocation();
+        return __libc_realloc(p, size);
+    }
+
+    void* memalign(size_t alignment, size_t size) {
+        countAllocation();
+        return __libc_memalign(alignment, size);
+    }
+
+    void* aligned_alloc(size_t alignment, size_t size) {
+        countAllocation();
+        return __libc_memalign(alignment, size);
+    }
+
+    int posix_memalign(void** p, size_t alignment, size_t size) {
+        countAllocation();
+        *p = __libc_memalign(alignment, size);
+        return *p != nullptr ? 0 : ENOMEM;
+    }
+
+    void free(void* p) {
+        __libc_free(p);
+    }
+}
+#endif
+
+// without the hooks operator new is all that is counted, with them it goes through malloc
+void* operator new(std::size_t size) {
+#if !defined(__GLIBC__)
+    countAllocation();
+#endif
+    if (void* p = std::malloc(size))
+        return p;
+    throw std::bad_alloc();
+}
+
+void operator delete(void* p) noexcept {
+    std::free(p);
+}
+
+struct Config {
+    const char* name;
+    int inputs, outputs, layers, channels, kernelWidth, dilationFactor, activation;
+    bool depthwise, residual;
+    bool perChannel;        // a mono lane per input channel
+    int internalBlock;      // fixed block size, 0 for the host's blocks
+    int oversampling;
+    int eco;                // 0 off, 1 half, 2 quarter
+    Conv1dKernel::Precision precision;
+    bool morph;
+    int threads;            // pipeline workers, 0 without
+};
+
+static const int blockSamples = 512;            // what prepareToPlay promised
+static const int crossfadeSamples = 4096;
+static const int hostBlocks[] = { 512, 37, 1024, 1, 300, 4096, 64, 511, 2048, 128 };
+
+// the model createModel builds for c, with weights from seed
+static std::unique_ptr<Model> createModel(const Config& c, int seed) {
+    int lanes = c.perChannel ? c.inputs : 1;
+    auto build = [&] (int s) {
+        return std::make_shared<Model>(c.perChannel ? 1 : c.inputs, c.perChannel ? 1 : c.outputs, c.layers, c.channels,
+                                       c.kernelWidth, c.dilationFactor, true, c.activation, Model::normal, s,
+                                       c.depthwise, c.residual);
+    };
+
+    auto source = build(seed);
+    if (!c.morph) {
+        if (c.eco > 0)
+            source->prune(0.0f, c.eco == 1 ? 0.5f : 0.25f);
+        source->setPrecision(c.precision);
+    }
+    auto model = Model::share(source);
+
+    if (c.morph) {
+        auto target = build(seed + 1000);
+        model->setMorphTarget(*target);
+        model->setMorph(0.25f, false);
+        model->finishMorph();
+        if (c.eco > 0)
+            model->prune(0.0f, c.eco == 1 ? 0.5f : 0.25f);
+        model->setPrecision(c.precision);
+    }
+
+    int maxBlockSize = c.internalBlock > 0 ? c.internalBlock : blockSamples;
+    model->prepareStreaming(maxBlockSize, lanes, c.internalBlock > 0, c.oversampling);
+
+    float condition[] = { 0.0f, 0.0f };
+    model->setCondition(condition);
+    model->setGains(1.0f, 1.0f);
+    model->optimise();
+
+    if (c.threads > 0)
+        model->preparePipeline(48000.0, c.threads);
+    return model;
+}
+
+static float* getModelInput(Model& m, int channel) {
+    return m.getLanes() > 1 ? m.getInputPointer(0, channel) : m.getInputPointer(channel);
+}
+
+static void getModelOutputs(Model& m, std::vector<float*>& pointers, std::vector<std::vector<float>>& buffer,
+                            int start, int numChannels) {
+    for (int row = 0; row < m.getLanes() * m.getOutputs(); ++row)
+        pointers[row] = row < numChannels ? buffer[row].data() + start : nullptr;
+}
+
+// the allocations of nBlocks host blocks through the processBlock sequence, with the
+// controls moving every block and a crossfade from fading to model every few blocks
+static long runBlocks(const Config& c, Model& model, Model& fading, int nBlocks) {
+    int inChannels = c.inputs, outChannels = c.outputs;
+    int maxHost = *std::max_element(std::begin(hostBlocks), std::end(hostBlocks));
+
+    // everything is allocated up front, like prepareToPlay does
+    std::vector<std::vector<float>> buffer(std::max(inChannels, outChannels), std::vector<float>(maxHost));
+    std::vector<std::vector<float>> fadeBuffer(outChannels, std::vector<float>(blockSamples));
+    std::vector<float*> outputPointers(std::max(1, inChannels) * outChannels);
+    std::vector<float*> fadingPointers(std::max(1, inChannels) * outChannels);
+
+    long before = allocations;
+    armed = true;
+
+    int crossfadePosition = crossfadeSamples;
+    for (int block = 0; block < nBlocks; block++) {
+        int numSamples = hostBlocks[block % (int) (sizeof(hostBlocks) / sizeof(hostBlocks[0]))];
+        for (int channel = 0; channel < inChannels; channel++)
+            for (int i = 0; i < numSamples; i++)
+                buffer[channel][i] = 0.5f * std::sin(0.01f * (float) (block * 97 + i) * (float) (channel + 1));
+
+        // a new model every 16 blocks, the two swap roles
+        if (block % 16 == 0)
+            crossfadePosition = 0;
+        bool fadingActive = crossfadePosition < crossfadeSamples;
+        Model& current = (block / 16) % 2 == 0 ? model : fading;
+        Model& old = &current == &model ? fading : model;
+
+        float condition[] = { 0.5f * std::sin(0.1f * (float) block), 0.5f * std::cos(0.07f * (float) block) };
+        current.setCondition(condition);
+        if (fadingActive)
+            old.setCondition(condition);
+
+        float inputGain = 1.0f + 0.25f * std::sin(0.05f * (float) block);
+        float outputGain = 1.0f - 0.25f * std::sin(0.03f * (float) block);
+        current.setGains(inputGain, outputGain);
+        if (fadingActive)
+            old.setGains(inputGain, outputGain);
+
+        float morph = 0.5f + 0.5f * std::sin(0.02f * (float) block);
+        bool spherical = (block / 32) % 2 == 1;
+        current.setMorph(morph, spherical);
+        if (fadingActive)
+            old.setMorph(morph, spherical);
+
+        for (int start = 0, n = 0; start < numSamples; start += n) {
+            n = std::min(numSamples - start, current.getMaxFrames());
+            if (fadingActive)
+                n = std::min({ n, old.getMaxFrames(), blockSamples });
+
+            for (int channel = 0; channel < inChannels; channel++) {
+                auto* input = getModelInput(current, channel);
+                std::copy(buffer[channel].data() + start, buffer[channel].data() + start + n, input);
+                if (fadingActive)
+                    std::copy(input, input + n, getModelInput(old, channel));
+            }
+
+            getModelOutputs(current, outputPointers, buffer, start, outChannels);
+            current.process(n, outputPointers.data());
+
+            if (fadingActive) {
+                getModelOutputs(old, fadingPointers, fadeBuffer, 0, outChannels);
+                old.process(n, fadingPointers.data());
+
+                for (int channel = 0; channel < outChannels; channel++) {
+                    float* out = buffer[channel].data() + start;
+                    const float* faded = fadeBuffer[channel].data();
+                    for (int i = 0; i < n; i++) {
+                        float g = std::min(1.0f, (float) (crossfadePosition + start + i) / (float) crossfadeSamples);
+                        out[i] = faded[i] + g * (out[i] - faded[i]);
+                    }
+                }
+            }
+        }
+
+        if (fadingActive)
+            crossfadePosition += numSamples;
+    }
+
+    armed = false;
+    return allocations - before;
+}
+
+int main(int argc, const char* argv[]) {
+    torch::NoGradGuard no_grad;
+    int nBlocks = argc > 1 ? std::max(1, std::atoi(argv[1])) : 2000;
+
+    // name, inputs, outputs, layers, channels, kernel, dilation, activation, depthwise, residual,
+    // per channel, internal block, oversampling, eco, precision, morph, threads
+    const Config configs[] = {
+        {"stereo",             2, 2,  6,  8, 3, 2, Model::Tanh,      false, false, false,   0, 1, 0, Conv1dKernel::Float32, false, 0},
+        {"per channel",        2, 2,  6,  8, 3, 2, Model::Tanh,      false, false, true,    0, 1, 0, Conv1dKernel::Float32, false, 0},
+        {"morph",              2, 2,  6, 16, 3, 2, Model::LeakyReLU, false, true,  false,   0, 1, 0, Conv1dKernel::Float32, true,  0},
+        {"fixed block",        2, 2,  6,  8, 3, 2, Model::Tanh,      false, false, false, 256, 1, 0, Conv1dKernel::Float32, false, 0},
+        {"oversampling 2x",    2, 2,  4,  8, 3, 2, Model::Tanh,      false, false, false,   0, 2, 0, Conv1dKernel::Float32, false, 0},
+        {"oversampling 4x",    1, 2,  4,  8, 5, 3, Model::Sine,      false, false, true,  128, 4, 0, Conv1dKernel::Float32, true,  0},
+        {"depthwise eco",      2, 2,  8, 16, 3, 2, Model::GELU,      true,  false, false,   0, 1, 1, Conv1dKernel::Float32, true,  0},
+        {"int8 eco",           2, 2,  8, 32, 3, 2, Model::Tanh,      false, true,  false,   0, 1, 2, Conv1dKernel::Int8,    true,  0},
+        {"linear merged",      2, 2,  4,  8, 3, 2, Model::Linear,    false, false, false,   0, 1, 0, Conv1dKernel::Float32, false, 0},
+        {"pipeline",           2, 2, 16, 32, 5, 2, Model::Tanh,      false, false, true,    0, 2, 0, Conv1dKernel::Float32, true,  2},
+    };
+
+    bool ok = true;
+    for (const auto& c : configs) {
+        auto model = createModel(c, 42);
+        auto fading = createModel(c, 43);
+
+        // a first pass outside the count, in case something lazy is left
+        runBlocks(c, *model, *fading, 32);
+        long count = runBlocks(c, *model, *fading, nBlocks);
+
+        std::cout << c.name << (model->isMerged() ? " (merged)" : "") << ": "
+                  << count << " allocations in " << nBlocks << " blocks" << std::endl;
+        ok = ok && count == 0;
+    }
+
+    std::cout << (ok ? "no allocations" : "FAILED, the audio thread allocates") << std::endl;
+    return ok ? 0 : 1;
+}
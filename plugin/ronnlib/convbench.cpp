@@ -0,0 +1,202 @@
+#include<iostream>
+#include<chrono>
+#include<vector>
+#include<atomic>
+#include<cstdlib>
+#include<new>
+#include<cmath>
+#include<algorithm>
+#include<torch/torch.h>
+
+#include "ronnlib.h"
+
+// count every heap allocation so we can check the streaming path never makes one
+static std::atomic<long> allocations(0);
+
+void* operator new(std::size_t size) {
+    allocations++;
+    if (void* p = std::malloc(size))
+        return p;
+    throw std::bad_alloc();
+}
+
+void operator delete(void* p) noexcept {
+    std::free(p);
+}
+
+// Compares the native Conv1d kernels against the libtorch Conv1d path over
+// the layers/kernel/channels ranges exposed by the plugin, streaming blocks
+// of blockSamples frames through each network like processBlock does.
+
+static double timeModel(Model& model, int nInputs, int blockSamples, int nBlocks) {
+    auto in = torch::rand({1, nInputs, blockSamples});
+
+    model.prepareStreaming(blockSamples);
+    for (int n = 0; n < 8; n++)         // warm up caches and allocators
+        model.forwardStreaming(in);
+
+    auto start = std::chrono::high_resolution_clock::now();
+    for (int n = 0; n < nBlocks; n++)
+        model.forwardStreaming(in);
+    auto end = std::chrono::high_resolution_clock::now();
+
+    return std::chrono::duration<double, std::micro>(end - start).count() / nBlocks;
+}
+
+// double precision references for the activation approximations
+static double referenceActivation(activations::Type act, double x) {
+    switch (act) {
+        case activations::LeakyReLU:    return x > 0.0 ? x : 0.2 * x;
+        case activations::Tanh:         return std::tanh(x);
+        case activations::Sigmoid:      return 1.0 / (1.0 + std::exp(-x));
+        case activations::ReLU:         return x > 0.0 ? x : 0.0;
+        case activations::ELU:          return x > 0.0 ? x : std::expm1(x);
+        case activations::SELU:         return 1.0507009873554805 * (x > 0.0 ? x : 1.6732632423543772 * std::expm1(x));
+        case activations::GELU:         return 0.5 * x * (1.0 + std::erf(x / std::sqrt(2.0)));
+        case activations::RReLU:        return x > 0.0 ? x : (11.0 / 48.0) * x;
+        case activations::Softplus:     return x > 20.0 ? x : std::log1p(std::exp(x));
+        case activations::Softshrink:   return x > 0.5 ? x - 0.5 : (x < -0.5 ? x + 0.5 : 0.0);
+        case activations::Sine:         return std::sin(x);
+        case activations::Sine30:       return std::sin((double) (30.0f * (float) x));
+        default:                        return x;
+    }
+}
+
+// check the error bounds documented in activations.h, returns false if any is exceeded
+static bool checkActivations() {
+    const char* names[] = {"Linear", "LeakyReLU", "Tanh", "Sigmoid", "ReLU", "ELU", "SELU",
+                           "GELU", "RReLU", "Softplus", "Softshrink", "Sine", "Sine30"};
+    const double bounds[] = {1e-7, 1e-7, 2e-7, 2e-7, 1e-7, 2e-7, 2e-7, 3e-7, 1e-7, 2e-7, 1e-7, 3e-7, 3e-7};
+    bool ok = true;
+
+    std::cout << "activation,max_error,bound" << std::endl;
+    for (int a = activations::Linear; a <= activations::Sine30; a++) {
+        auto act = static_cast<activations::Type>(a);
+        double range = (act == activations::Sine30) ? 100.0 : 20.0;
+        int n = 1 << 20;
+
+        std::vector<float> x(n);
+        for (int i = 0; i < n; i++)
+            x[i] = (float) (-range + 2.0 * range * i / (n - 1));
+        std::vector<float> y = x;
+        activations::apply(y.data(), n, act);
+
+        double error = 0.0;
+        for (int i = 0; i < n; i++) {
+            double ref = referenceActivation(act, x[i]);
+            error = std::max(error, std::abs(y[i] - ref) / std::max(1.0, std::abs(ref)));
+        }
+        ok = ok && error <= bounds[a];
+        std::cout << names[a] << "," << error << "," << bounds[a] << std::endl;
+    }
+    return ok;
+}
+
+// largest difference between two outputs, relative to the scale of the expected one
+static double relativeDifference(const torch::Tensor& expected, const torch::Tensor& actual) {
+    double scale = std::max(1.0, expected.abs().max().item<double>());
+    return (expected - actual).abs().max().item<double>() / scale;
+}
+
+int main(){
+
+    // don't compute gradients
+    torch::NoGradGuard no_grad_guard; 
+    torch::set_num_threads(1);
+
+    int nInputs      = 2;
+    int nOutputs     = 2;
+    int blockSamples = 256;
+    int nBlocks      = 200;
+
+    std::vector<int> layers   = {1, 6, 12, 24};
+    std::vector<int> kernels  = {1, 3, 5, 7, 16, 32, 64};
+    std::vector<int> channels = {1, 2, 4, 8, 16, 32, 64};
+
+    std::cout << "isa: " << Conv1dKernel::getISAName(Conv1dKernel::detectISA()) << std::endl;
+    std::cout << "layers,kernel,channels,torch_us,native_us,speedup" << std::endl;
+
+    for (auto l : layers) {
+        for (auto k : kernels) {
+            for (auto c : channels) {
+                Model model(nInputs, nOutputs, l, c, k, 1, true, Model::ReLU, Model::normal, 42, false);
+
+                model.setBackend(Model::Torch);
+                double torchTime = timeModel(model, nInputs, blockSamples, nBlocks);
+                model.setBackend(Model::Native);
+                double nativeTime = timeModel(model, nInputs, blockSamples, nBlocks);
+
+                std::cout << l << "," << k << "," << c << ","
+                          << torchTime << "," << nativeTime << ","
+                          << torchTime / nativeTime << std::endl;
+            }
+        }
+    }
+
+    bool activationsOk = checkActivations();
+
+    // the fused native kernels against libtorch for each activation, the two sum in a different
+    // order and Sine30 multiplies those rounding differences by 30 in every layer
+    const double tolerances[] = {1e-4, 1e-4, 1e-4, 1e-4, 1e-4, 1e-4, 1e-4, 1e-4, 1e-4, 1e-4, 1e-4, 1e-3, 5e-2};
+    bool kernelsOk = true;
+    std::cout << "activation,torch_us,native_us,max_difference,tolerance" << std::endl;
+    for (int a = Model::Linear; a <= Model::Sine30; a++) {
+        Model model(nInputs, nOutputs, 6, 8, 3, 2, true, a, Model::normal, 42, false);
+        auto in = torch::rand({1, nInputs, 4096}) * 2 - 1;
+
+        model.setBackend(Model::Torch);
+        auto expected = model.forward(in);
+        double torchTime = timeModel(model, nInputs, blockSamples, nBlocks);
+        model.setBackend(Model::Native);
+        auto actual = model.forward(in);
+        double nativeTime = timeModel(model, nInputs, blockSamples, nBlocks);
+
+        double difference = relativeDifference(expected, actual);
+        kernelsOk = kernelsOk && difference <= tolerances[a];
+        std::cout << a << "," << torchTime << "," << nativeTime << ","
+                  << difference << "," << tolerances[a] << std::endl;
+    }
+
+    // depthwise-separable hidden layers against dense ones of the same width,
+    // and the fused native kernels against libtorch's depthwise and pointwise convs
+    std::cout << "channels,dense_us,separable_us,speedup,dense_flops,separable_flops,max_difference" << std::endl;
+    for (auto c : {16, 32, 64}) {
+        Model dense(nInputs, nOutputs, 12, c, 3, 2, true, Model::Tanh, Model::normal, 42, false);
+        Model separable(nInputs, nOutputs, 12, c, 3, 2, true, Model::Tanh, Model::normal, 42, true);
+        auto in = torch::rand({1, nInputs, 4096}) * 2 - 1;
+
+        separable.setBackend(Model::Torch);
+        auto expected = separable.forward(in);
+        separable.setBackend(Model::Native);
+        auto actual = separable.forward(in);
+        double difference = relativeDifference(expected, actual);
+        kernelsOk = kernelsOk && difference <= 1e-4;
+
+        double denseTime = timeModel(dense, nInputs, blockSamples, nBlocks);
+        double separableTime = timeModel(separable, nInputs, blockSamples, nBlocks);
+        std::cout << c << "," << denseTime << "," << separableTime << "," << denseTime / separableTime << ","
+                  << dense.getNumFlops() << "," << separable.getNumFlops() << ","
+                  << difference << std::endl;
+    }
+
+    // once prepared, the native streaming path must not touch the heap
+    Model model(nInputs, nOutputs, 6, 8, 3, 2, true, Model::Tanh, Model::normal, 42, false);
+    model.prepareStreaming(blockSamples);
+
+    std::vector<float> out(nOutputs * blockSamples);
+    std::vector<float*> outputs = {out.data(), out.data() + blockSamples};
+
+    long before = allocations;
+    for (int n = 0; n < 10000; n++) {
+        for (int c = 0; c < nInputs; c++) {
+            float* in = model.getInputPointer(c);
+            for (int t = 0; t < blockSamples; t++)
+                in[t] = std::sin(0.01f * (n * blockSamples + t));
+        }
+        model.process(blockSamples, outputs.data());
+    }
+    long count = allocations - before;
+
+    std::cout << "allocations in 10000 streaming blocks: " << count << std::endl;
+    return (count == 0 && activationsOk && kernelsOk) ? 0 : 1;
+}
@@ -0,0 +1,630 @@
+#include<iostream>
+#include<fstream>
+#include<sstream>
+#include<string>
+#include<cstring>
+#include<cstdint>
+#include<cmath>
+#include<vector>
+#include<deque>
+#include<map>
+#include<memory>
+#include<mutex>
+#include<thread>
+#include<algorithm>
+#include<torch/torch.h>
+
+#include "ronnlib.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+ #include<xmmintrin.h>
+#endif
+
+// Offline renderer, runs WAV files through the same processing as the plugin:
+//
+//   ronnrender [--preset file] [--layers n] ... [--threads n] [--block n] [--chunk n]
+//              [--weights file] [--save-weights file [--inputs n]] [--out-dir dir] input.wav...
+//
+// Presets are "parameter = value" lines using the plugin's parameter IDs
+// (layers, kernel, channels, dilation, activation, initType, seed, useBias,
+// depthwise, residual, cond1, cond2, morphSeed, morph, morphMode, precision,
+// eco, inputGain, outputGain in dB), and take the same values as the plugin's parameters.
+// Command line options override the preset. The renderer runs the network the way
+// the plugin does with internalBlock, oversampling and dualMono off, presets may
+// list those at 0 but anything else is refused.
+//
+// --save-weights writes the weights of the preset's model with --inputs
+// channels (2 by default) to a snapshot file (snapshot.h), --weights renders
+// with the weights of such a file, which is mapped rather than read and
+// replaces the preset's network hyperparameters. Inputs with a different
+// number of channels than the snapshot's model get weights from the seed.
+//
+// Each file is split into chunks that are rendered independently on a work
+// stealing pool. A chunk first runs the network over the receptive field
+// before its start, rounded up to whole blocks so every frame lands at the
+// same place in a block as it would in the plugin and goes through the same
+// SIMD or scalar path. The gains are folded into the model's weights like in
+// the plugin. The high pass filter is recursive and cheap, so it is applied in
+// order as finished chunks are written.
+// Output is 32 bit float stereo, sample for sample what the plugin produces
+// with the same host block size on a mono or stereo bus with the settings above
+// off, except after silence: the plugin stops running the network once the
+// input has been silent for longer than it reaches back, and outputs zeros
+// until the input returns, the renderer keeps running it.
+
+//==============================================================================
+struct Preset {
+    int layers = 6, kernel = 3, channels = 8, dilation = 1;
+    int activation = 1, initType = 1, seed = 42;
+    bool useBias = false, depthwise = false, residual = false;
+    float inputGain = 0.0f, outputGain = 0.0f;      // dB
+    float condition[2] = {0.0f, 0.0f};              // FiLM conditioning
+    int morphSeed = 43, morphMode = 1;              // weight morph, mode 1 is spherical
+    float morph = 0.0f;
+    int precision = 0;                              // of the hidden layers, 1 is Int8
+    int eco = 0;                                    // pruning, 1 keeps half the hidden weights, 2 a quarter
+
+    bool set(const std::string& key, const std::string& value) {
+        if      (key == "layers")       layers = std::stoi(value);
+        else if (key == "kernel")       kernel = std::stoi(value);
+        else if (key == "channels")     channels = std::stoi(value);
+        else if (key == "dilation")     dilation = std::stoi(value);
+        else if (key == "activation")   activation = std::stoi(value);
+        else if (key == "initType")     initType = std::stoi(value);
+        else if (key == "seed")         seed = std::stoi(value);
+        else if (key == "useBias")      useBias = value == "1" || value == "true";
+        else if (key == "depthwise")    depthwise = value == "1" || value == "true";
+        else if (key == "residual")     residual = value == "1" || value == "true";
+        else if (key == "inputGain")    inputGain = std::stof(value);
+        else if (key == "outputGain")   outputGain = std::stof(value);
+        else if (key == "cond1")        condition[0] = std::stof(value);
+        else if (key == "cond2")        condition[1] = std::stof(value);
+        else if (key == "morphSeed")    morphSeed = std::stoi(value);
+        else if (key == "morph")        morph = std::stof(value);
+        else if (key == "morphMode")    morphMode = std::stoi(value);
+        else if (key == "precision")    precision = std::stoi(value);
+        else if (key == "eco")          eco = std::stoi(value);
+        else if (isUnsupported(key))    return value == "0" || value == "false";
+        else return false;
+        return true;
+    }
+
+    // plugin parameters the renderer doesn't reproduce, accepted when they are off
+    static bool isUnsupported(const std::string& key) {
+        return key == "internalBlock" || key == "oversampling" || key == "dualMono";
+    }
+
+    static void reject(const std::string& key) {
+        if (isUnsupported(key))
+            std::cerr << key << " is not supported by the renderer, only " << key << " = 0" << std::endl;
+        else
+            std::cerr << "unknown preset parameter " << key << std::endl;
+    }
+
+    bool load(const std::string& path) {
+        std::ifstream file(path);
+        if (!file)
+            return false;
+        std::string line;
+        while (std::getline(file, line)) {
+            line = line.substr(0, line.find('#'));
+            auto eq = line.find('=');
+            if (eq == std::string::npos)
+                continue;
+            std::string key, value;
+            std::istringstream(line.substr(0, eq)) >> key;
+            std::istringstream(line.substr(eq + 1)) >> value;
+            if (!key.empty() && !set(key, value)) {
+                reject(key);
+                return false;
+            }
+        }
+        return true;
+    }
+
+    void set(const WeightSnapshot::Hyperparameters& model) {
+        layers = model.layers;
+        kernel = model.kernelWidth;
+        channels = model.channels;
+        dilation = model.dilationFactor;
+        activation = model.activation;
+        initType = model.initType;
+        seed = model.seed;
+        useBias = model.bias != 0;
+        depthwise = model.depthwise != 0;
+        residual = model.residual != 0;
+    }
+
+    int receptiveField() const {
+        // same as RonnAudioProcessor::calculateReceptiveField
+        double rf = 1;
+        for (int layer = 0; layer < layers; ++layer)
+            rf = rf + ((kernel-1) * pow(dilation, layer));
+        return (int) rf;
+    }
+};
+
+// juce::Decibels::decibelsToGain
+static float decibelsToGain(float dB) {
+    return dB > -100.0f ? std::pow(10.0f, dB * 0.05f) : 0.0f;
+}
+
+// the plugin's output high pass, juce::IIRFilter with IIRCoefficients::makeHighPass
+struct HighPass {
+    float c[5];
+    float v1 = 0.0f, v2 = 0.0f;
+
+    HighPass(double sampleRate, double frequency, double q) {
+        const double n = std::tan(M_PI * frequency / sampleRate);
+        const double nSquared = n * n;
+        const double c1 = 1.0 / (1.0 + n / q + nSquared);
+        const double b[3] = {c1, c1 * -2.0, c1};
+        const double a[3] = {1.0, c1 * 2.0 * (nSquared - 1.0), c1 * (1.0 - n / q + nSquared)};
+        c[0] = (float) (b[0] / a[0]);
+        c[1] = (float) (b[1] / a[0]);
+        c[2] = (float) (b[2] / a[0]);
+        c[3] = (float) (a[1] / a[0]);
+        c[4] = (float) (a[2] / a[0]);
+    }
+
+    void process(float* samples, int numSamples) {
+        float lv1 = v1, lv2 = v2;
+        for (int i = 0; i < numSamples; ++i) {
+            const float in = samples[i];
+            const float out = c[0] * in + lv1;
+            samples[i] = out;
+            lv1 = c[1] * in - c[3] * out + lv2;
+            lv2 = c[2] * in - c[4] * out;
+        }
+        if (! (lv1 < -1.0e-8f || lv1 > 1.0e-8f)) lv1 = 0.0f;
+        if (! (lv2 < -1.0e-8f || lv2 > 1.0e-8f)) lv2 = 0.0f;
+        v1 = lv1;
+        v2 = lv2;
+    }
+};
+
+// flush denormals like juce::ScopedNoDenormals does for processBlock
+static void disableDenormals() {
+#if defined(__x86_64__) || defined(__i386__)
+    _mm_setcsr(_mm_getcsr() | 0x8040);
+#elif defined(__aarch64__)
+    uint64_t fpcr;
+    asm volatile("mrs %0, fpcr" : "=r"(fpcr));
+    asm volatile("msr fpcr, %0" : : "r"(fpcr | (1ull << 24)));
+#endif
+}
+
+//==============================================================================
+// minimal streaming WAV reader for 16/24/32 bit PCM and 32 bit float
+struct WavReader {
+    std::ifstream file;
+    int channels = 0, bitsPerSample = 0;
+    bool isFloat = false;
+    double sampleRate = 0;
+    long dataOffset = 0, numFrames = 0;
+
+    bool open(const std::string& path) {
+        file.open(path, std::ios::binary);
+        char riff[12];
+        if (!file.read(riff, 12) || std::memcmp(riff, "RIFF", 4) != 0 || std::memcmp(riff + 8, "WAVE", 4) != 0)
+            return false;
+
+        char header[8];
+        while (file.read(header, 8)) {
+            uint32_t size;
+            std::memcpy(&size, header + 4, 4);
+            if (std::memcmp(header, "fmt ", 4) == 0) {
+                std::vector<char> fmt(size);
+                file.read(fmt.data(), size);
+                if (size & 1)
+                    file.seekg(1, std::ios::cur);
+                uint16_t format, nChannels, bits;
+                uint32_t rate;
+                std::memcpy(&format, &fmt[0], 2);
+                std::memcpy(&nChannels, &fmt[2], 2);
+                std::memcpy(&rate, &fmt[4], 4);
+                std::memcpy(&bits, &fmt[14], 2);
+                if (format == 0xFFFE && size >= 26)         // WAVE_FORMAT_EXTENSIBLE, the sub format follows
+                    std::memcpy(&format, &fmt[24], 2);
+                channels = nChannels;
+                sampleRate = rate;
+                bitsPerSample = bits;
+                isFloat = (format == 3);
+                if (!(format == 1 || (format == 3 && bits == 32)))
+                    return false;
+            }
+            else if (std::memcmp(header, "data", 4) == 0) {
+                dataOffset = (long) file.tellg();
+                numFrames = channels > 0 ? size / (channels * (bitsPerSample / 8)) : 0;
+                return channels > 0;
+            }
+            else
+                file.seekg(size + (size & 1), std::ios::cur);
+        }
+        return false;
+    }
+
+    // frames [start, start + n) into one row per channel
+    void read(long start, int n, float* const* rows) {
+        const int bytes = bitsPerSample / 8;
+        std::vector<unsigned char> raw((size_t) n * channels * bytes);
+        file.clear();
+        file.seekg(dataOffset + start * channels * bytes);
+        file.read((char*) raw.data(), raw.size());
+
+        for (int t = 0; t < n; t++) {
+            for (int c = 0; c < channels; c++) {
+                const unsigned char* p = raw.data() + ((size_t) t * channels + c) * bytes;
+                float v;
+                if (isFloat)
+                    std::memcpy(&v, p, 4);
+                else if (bytes == 2)
+                    v = (int16_t) (p[0] | (p[1] << 8)) / 32768.0f;
+                else if (bytes == 3)
+                    v = (int32_t) ((uint32_t) (p[0] << 8 | p[1] << 16 | p[2] << 24)) / 2147483648.0f;
+                else if (bytes == 4)
+                    v = (int32_t) ((uint32_t) (p[0] | p[1] << 8 | p[2] << 16 | p[3] << 24)) / 2147483648.0f;
+                else
+                    v = (p[0] - 128) / 128.0f;
+                rows[c][t] = v;
+            }
+        }
+    }
+};
+
+// 32 bit float WAV writer, the sizes are filled in by close()
+struct WavWriter {
+    std::ofstream file;
+    int channels = 0;
+    long framesWritten = 0;
+    std::vector<float> interleaved;
+
+    bool open(const std::string& path, int nChannels, double sampleRate) {
+        channels = nChannels;
+        file.open(path, std::ios::binary);
+        if (!file)
+            return false;
+        writeHeader((uint32_t) sampleRate);
+        return true;
+    }
+
+    void writeHeader(uint32_t rate) {
+        uint32_t dataSize = (uint32_t) (framesWritten * channels * 4);
+        uint32_t riffSize = 36 + dataSize;
+        uint32_t fmtSize = 16, byteRate = rate * channels * 4;
+        uint16_t format = 3, nChannels = (uint16_t) channels, blockAlign = (uint16_t) (channels * 4), bits = 32;
+        file.seekp(0);
+        file.write("RIFF", 4);          file.write((const char*) &riffSize, 4);
+        file.write("WAVEfmt ", 8);      file.write((const char*) &fmtSize, 4);
+        file.write((const char*) &format, 2);
+        file.write((const char*) &nChannels, 2);
+        file.write((const char*) &rate, 4);
+        file.write((const char*) &byteRate, 4);
+        file.write((const char*) &blockAlign, 2);
+        file.write((const char*) &bits, 2);
+        file.write("data", 4);          file.write((const char*) &dataSize, 4);
+        sampleRateWritten = rate;
+    }
+
+    void write(const float* const* rows, int n) {
+        interleaved.resize((size_t) n * channels);
+        for (int t = 0; t < n; t++)
+            for (int c = 0; c < channels; c++)
+                interleaved[(size_t) t * channels + c] = rows[c][t];
+        file.write((const char*) interleaved.data(), interleaved.size() * sizeof(float));
+        framesWritten += n;
+    }
+
+    void close() {
+        writeHeader(sampleRateWritten);
+        file.close();
+    }
+
+    uint32_t sampleRateWritten = 0;
+};
+
+//==============================================================================
+struct Job;
+
+struct Task {
+    Job* job;
+    int chunk;
+};
+
+// a file being rendered, finished chunks wait in pending until all the
+// chunks before them have been written
+struct Job {
+    std::string inputPath, outputPath;
+    int inputs = 0, numChunks = 0;
+    long numFrames = 0;
+    double sampleRate = 0;
+
+    std::mutex lock;
+    WavWriter writer;
+    std::vector<HighPass> highPassFilters;
+    std::map<int, std::vector<std::vector<float>>> pending;
+    int nextChunk = 0;
+};
+
+static const int nOutputs = 2;
+
+// the snapshot's weights when they fit, otherwise initialised from the seed
+static std::unique_ptr<Model> buildModel(const Preset& preset, int nInputs, const WeightSnapshot* weights) {
+    // libtorch seeds a process wide generator, so models are built one at a time
+    static std::mutex buildLock;
+    std::lock_guard<std::mutex> guard(buildLock);
+    return std::unique_ptr<Model>(new Model(nInputs, nOutputs, preset.layers, preset.channels,
+                                            preset.kernel, preset.dilation, preset.useBias,
+                                            preset.activation, preset.initType, preset.seed,
+                                            preset.depthwise, preset.residual, weights));
+}
+
+class Renderer {
+    public:
+        Renderer(const Preset& p, const WeightSnapshot* w, int numThreads, int block, int chunk)
+            : preset(p), weights(w), blockSize(block), chunkSize(chunk), queues(numThreads), queueLocks(numThreads) {
+            // warm up over the receptive field, on the same block grid as the plugin
+            int rf = preset.receptiveField();
+            warmup = ((rf - 1 + blockSize - 1) / blockSize) * blockSize;
+        }
+
+        void add(Job* job) {
+            for (int c = 0; c < job->numChunks; c++) {
+                std::lock_guard<std::mutex> guard(queueLocks[nextQueue]);
+                queues[nextQueue].push_back({job, c});
+                nextQueue = (nextQueue + 1) % (int) queues.size();
+            }
+        }
+
+        void run() {
+            std::vector<std::thread> threads;
+            for (int i = 0; i < (int) queues.size(); i++)
+                threads.emplace_back([this, i] { worker(i); });
+            for (auto& t : threads)
+                t.join();
+        }
+
+    private:
+        // owners take their own chunks in order, idle workers steal from the back of the others
+        bool nextTask(int self, Task& task) {
+            {
+                std::lock_guard<std::mutex> guard(queueLocks[self]);
+                if (!queues[self].empty()) {
+                    task = queues[self].front();
+                    queues[self].pop_front();
+                    return true;
+                }
+            }
+            for (int i = 1; i < (int) queues.size(); i++) {
+                int victim = (self + i) % (int) queues.size();
+                std::lock_guard<std::mutex> guard(queueLocks[victim]);
+                if (!queues[victim].empty()) {
+                    task = queues[victim].back();
+                    queues[victim].pop_back();
+                    return true;
+                }
+            }
+            return false;
+        }
+
+        std::unique_ptr<Model> createModel(int nInputs) {
+            std::unique_ptr<Model> model(buildModel(preset, nInputs, weights));
+
+            // the plugin leaves the weights as they are at a morph of zero
+            if (preset.morph != 0.0f && preset.morphSeed != preset.seed) {
+                Preset target = preset;
+                target.seed = preset.morphSeed;
+                model->setMorphTarget(*buildModel(target, nInputs, nullptr));
+                model->setMorph(preset.morph, preset.morphMode == 1);
+                model->finishMorph();
+            }
+            if (preset.eco > 0)
+                model->prune(0.0f, preset.eco == 1 ? 0.5f : 0.25f);
+            model->setPrecision(preset.precision > 0 ? Conv1dKernel::Int8 : Conv1dKernel::Float32);
+            model->prepareStreaming(blockSize);
+            model->setCondition(preset.condition);
+            model->setGains(decibelsToGain(preset.inputGain), decibelsToGain(preset.outputGain));
+            model->optimise();
+            return model;
+        }
+
+        void worker(int self) {
+            torch::NoGradGuard no_grad;
+            disableDenormals();
+
+            std::unique_ptr<Model> models[3];       // by number of inputs
+            WavReader reader;
+            std::string readerPath;
+            std::vector<std::vector<float>> input;
+
+            Task task;
+            while (nextTask(self, task)) {
+                Job& job = *task.job;
+                auto& model = models[job.inputs];
+                if (model == nullptr)
+                    model = createModel(job.inputs);
+                if (readerPath != job.inputPath) {
+                    reader = WavReader();
+                    reader.open(job.inputPath);
+                    readerPath = job.inputPath;
+                }
+
+                long start = (long) task.chunk * chunkSize;
+                long end = std::min(job.numFrames, start + chunkSize);
+                long from = std::max(0L, start - warmup);
+                int length = (int) (end - start);
+
+                std::vector<std::vector<float>> output(nOutputs, std::vector<float>(length));
+                std::vector<float*> inputRows(job.inputs), outputRows(nOutputs);
+                input.resize(job.inputs);
+                for (auto& row : input)
+                    row.resize(blockSize);
+                for (int c = 0; c < job.inputs; c++)
+                    inputRows[c] = input[c].data();
+
+                model->resetState();
+                std::vector<float> discard(nOutputs * blockSize);
+                for (long t = from; t < end; t += blockSize) {
+                    int n = (int) std::min<long>(blockSize, end - t);
+                    reader.read(t, n, inputRows.data());
+                    for (int c = 0; c < job.inputs; c++)
+                        std::memcpy(model->getInputPointer(c), input[c].data(), n * sizeof(float));
+                    for (int c = 0; c < nOutputs; c++)
+                        outputRows[c] = t >= start ? output[c].data() + (t - start) : discard.data() + c * blockSize;
+                    model->process(n, outputRows.data());
+                }
+
+                finish(job, task.chunk, std::move(output));
+            }
+        }
+
+        // write out every chunk that is now next in line
+        void finish(Job& job, int chunk, std::vector<std::vector<float>> output) {
+            std::lock_guard<std::mutex> guard(job.lock);
+            job.pending[chunk] = std::move(output);
+
+            while (!job.pending.empty() && job.pending.begin()->first == job.nextChunk) {
+                auto& rows = job.pending.begin()->second;
+                int n = (int) rows[0].size();
+                std::vector<float*> pointers(nOutputs);
+                for (int c = 0; c < nOutputs; c++) {
+                    // the plugin filters each host block and snaps the filter state to
+                    // zero in between, chunks start on block boundaries so we can too
+                    for (int t = 0; t < n; t += blockSize)
+                        job.highPassFilters[c].process(rows[c].data() + t, std::min(blockSize, n - t));
+                    pointers[c] = rows[c].data();
+                }
+                job.writer.write(pointers.data(), n);
+                job.pending.erase(job.pending.begin());
+
+                if (++job.nextChunk == job.numChunks) {
+                    job.writer.close();
+                    std::cerr << "rendered " << job.outputPath << std::endl;
+                }
+            }
+        }
+
+        const Preset preset;
+        const WeightSnapshot* weights;
+        int blockSize, chunkSize;
+        long warmup;
+
+        std::vector<std::deque<Task>> queues;
+        std::vector<std::mutex> queueLocks;
+        int nextQueue = 0;
+};
+
+//==============================================================================
+static void usage() {
+    std::cerr << "usage: ronnrender [--preset file] [--<parameter> value]... [--threads n] [--block n]\n"
+                 "                  [--chunk n] [--weights file] [--save-weights file [--inputs n]]\n"
+                 "                  [--out-dir dir] input.wav..." << std::endl;
+}
+
+int main(int argc, char* argv[]){
+
+    torch::set_num_threads(1);
+
+    Preset preset;
+    int numThreads = std::max(1u, std::thread::hardware_concurrency());
+    int blockSize = 512;
+    int chunkSize = 1 << 16;
+    std::string outDir, weightsPath, saveWeightsPath;
+    int saveInputs = 2;
+    std::vector<std::string> files;
+
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg.compare(0, 2, "--") != 0) {
+            files.push_back(arg);
+            continue;
+        }
+        if (i + 1 >= argc) {
+            usage();
+            return 1;
+        }
+        std::string key = arg.substr(2), value = argv[++i];
+        if (key == "preset") {
+            if (!preset.load(value)) {
+                std::cerr << "could not read preset " << value << std::endl;
+                return 1;
+            }
+        }
+        else if (key == "threads")  numThreads = std::max(1, std::stoi(value));
+        else if (key == "block")    blockSize = std::max(1, std::stoi(value));
+        else if (key == "chunk")    chunkSize = std::max(1, std::stoi(value));
+        else if (key == "out-dir")  outDir = value;
+        else if (key == "weights")  weightsPath = value;
+        else if (key == "save-weights") saveWeightsPath = value;
+        else if (key == "inputs")   saveInputs = std::min(2, std::max(1, std::stoi(value)));
+        else if (!preset.set(key, value)) {
+            Preset::reject(key);
+            usage();
+            return 1;
+        }
+    }
+    std::unique_ptr<WeightSnapshot> weights;
+    if (!weightsPath.empty()) {
+        weights.reset(new WeightSnapshot(weightsPath));
+        if (!weights->isValid() || weights->getHeader().model.outputs != nOutputs) {
+            std::cerr << "could not load weights from " << weightsPath << std::endl;
+            return 1;
+        }
+        preset.set(weights->getHeader().model);
+    }
+    if (!saveWeightsPath.empty()) {
+        std::vector<char> snapshot;
+        buildModel(preset, saveInputs, weights.get())->saveWeights(snapshot);
+        if (!WeightSnapshot::writeFile(saveWeightsPath, snapshot)) {
+            std::cerr << "could not write " << saveWeightsPath << std::endl;
+            return 1;
+        }
+        if (files.empty())
+            return 0;
+    }
+    if (files.empty()) {
+        usage();
+        return 1;
+    }
+
+    // chunks start on block boundaries
+    chunkSize = std::max(1, chunkSize / blockSize) * blockSize;
+    Renderer renderer(preset, weights.get(), numThreads, blockSize, chunkSize);
+
+    std::vector<std::unique_ptr<Job>> jobs;
+    for (auto& path : files) {
+        WavReader reader;
+        if (!reader.open(path) || reader.channels > 2) {
+            std::cerr << "skipping " << path << ", not a mono or stereo WAV file" << std::endl;
+            continue;
+        }
+
+        std::unique_ptr<Job> job(new Job);
+        job->inputPath = path;
+        auto name = path.substr(path.find_last_of('/') + 1);
+        auto stem = name.substr(0, name.find_last_of('.'));
+        auto dir = outDir.empty() ? path.substr(0, path.size() - name.size()) : outDir + "/";
+        job->outputPath = dir + stem + "_ronn.wav";
+        job->inputs = reader.channels;
+        job->numFrames = reader.numFrames;
+        job->sampleRate = reader.sampleRate;
+        job->numChunks = (int) std::max(1L, (reader.numFrames + chunkSize - 1) / chunkSize);
+        if (weights != nullptr && weights->getHeader().model.inputs != job->inputs)
+            std::cerr << path << " has " << job->inputs << " channels, the weights are for "
+                      << weights->getHeader().model.inputs << ", using the seed instead" << std::endl;
+
+        // same filter as RonnAudioProcessor::prepareToPlay
+        for (int c = 0; c < nOutputs; c++)
+            job->highPassFilters.push_back(HighPass(reader.sampleRate, 10.0, 10.0));
+
+        if (!job->writer.open(job->outputPath, nOutputs, reader.sampleRate)) {
+            std::cerr << "could not write " << job->outputPath << std::endl;
+            continue;
+        }
+        renderer.add(job.get());
+        jobs.push_back(std::move(job));
+    }
+
+    renderer.run();
+    return 0;
+}
@@ -1,144 +1,409 @@
 #include<iostream>
+#include<fstream>
+#include<sstream>
 #include<string>
 #include<cstring>
 #include<cstdint>
+#include<chrono>
+#include<vector>
+#include<algorithm>
+#include<cmath>
+#include<limits>
+#include<functional>
+#include<sys/resource.h>
 #include<torch/torch.h>
 
-struct Model : torch::nn::Module {
-    Model(int nInputs, 
-          int nOutputs, 
-          int nLayers, 
-          int nChannels, 
-          int kernelWidth, 
-          bool bias, 
-          std::string act,
-          float* dilations) {
-
-        for (int i = 0; i < nLayers; i++) {
-            if (i == 0) {
-                inChannels = nInputs;
-                outChannels = nChannels;
-            }
-            else if (i + 1 == nLayers) {
-                inChannels = nChannels;
-                outChannels = nOutputs;
-            }
-            else {
-                inChannels = nChannels;
-                outChannels = nChannels;
-            }
-            conv.push_back(torch::nn::Conv1d(
-                torch::nn::Conv1dOptions(inChannels,outChannels,kernelWidth)
-                .stride(1)
-                .dilation(dilations[i])
-                .bias(bias)));
-        }
+#include "ronnlib.h"
+
+// Benchmark of the streaming Model used by the plugin. Each point builds a
+// network, streams blocks of new input through Model::process() the way
+// processBlock does, and times every block on its own.
+//
+//   ronnlib [--format csv|json] [--full] [--backend native|torch] [--seconds s]
+//           [--internal-block n] [--oversampling 2|4|8] [--precision float32|float16|int8]
+//           [--prune keep]
+//   ronnlib --precision-report|--prune-report [--seconds s]
+//
+// The default sweep varies one hyperparameter at a time around the baseline
+// below, --full runs the whole cartesian product (tens of thousands of points).
+// --internal-block runs the network in fixed blocks of n frames collected from
+// the swept host block size, like the plugin's Internal Block setting.
+// --oversampling runs the network at that multiple of the rate, the time
+// includes the resampling, which is also timed on its own.
+// --precision runs the hidden layers quantised (Model::setPrecision).
+// --prune keeps that fraction of the hidden layer weights (Model::prune).
+//
+// --precision-report compares float16 and int8 with float32 on wide networks
+// for every activation, the SNR of the output in dB against float32 for the
+// same input (a sine sweep with noise) and the speedup of ns_per_sample, to
+// pick the precision a preset can live with. --prune-report does the same for
+// pruning to keep fractions of 3/4, 1/2 and 1/4 (the plugin's eco mode), with
+// the sparsity reached and the cpu_saved fraction of ns_per_sample.
+//
+// Columns:
+//   ns_per_sample   mean wall time per frame (all output channels)
+//   rtf_44k/48k/96k processing time / audio time at that rate, < 1 keeps up
+//   p50/p99/max_us  block latency percentiles
+//   peak_rss_kb     peak resident set size while running the point (process
+//                   peak so far where the os can't reset it)
+//   resampler_ns_per_sample  up and downsampling alone, part of ns_per_sample
+//   precision       of the hidden layers, float32 where the kernels have no quantised loops
+//   sparsity        fraction of the hidden layer weights that are zero
+//   parameters      weights and biases of the model (Model::getNumParameters)
+//   flops_per_frame of the convolutions for one frame of the outputs (Model::getNumFlops),
+//                   the depthwise toggle makes the hidden layers depthwise-separable
+
+struct Config {
+    int layers, channels, kernel, dilation, activation;
+    bool depthwise, bias;
+    int blockSize;
+};
+
+struct Result {
+    Config config;
+    int receptiveField;
+    double nsPerSample, rtf44, rtf48, rtf96;
+    double p50, p99, max;
+    long peakRSS;
+    int oversampling;
+    double resamplerNsPerSample;
+    int precision;
+    double sparsity;
+    int parameters;
+    long flops;
+};
+
+static const char* precisionNames[] = {"float32", "float16", "int8"};
+
+static const char* activationNames[] = {"Linear", "LeakyReLU", "Tanh", "Sigmoid", "ReLU", "ELU", "SELU",
+                                        "GELU", "RReLU", "Softplus", "Softshrink", "Sine", "Sine30"};
+
+// peak resident set size in kilobytes
+static long getPeakRSS() {
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+#if defined(__APPLE__)
+    return usage.ru_maxrss / 1024;      // bytes on macOS
+#else
+    return usage.ru_maxrss;
+#endif
+}
+
+// linux lets us reset the peak so each point reports its own
+static void resetPeakRSS() {
+#if defined(__linux__)
+    std::ofstream clearRefs("/proc/self/clear_refs");
+    if (clearRefs)
+        clearRefs << "5";
+#endif
+}
+
+static long getCurrentPeakRSS() {
+#if defined(__linux__)
+    std::ifstream status("/proc/self/status");
+    std::string line;
+    while (std::getline(status, line)) {
+        if (line.compare(0, 6, "VmHWM:") == 0)
+            return std::stol(line.substr(6));
+    }
+#endif
+    return getPeakRSS();
+}
+
+static double percentile(const std::vector<double>& sorted, double p) {
+    size_t index = std::min(sorted.size() - 1, (size_t) std::ceil(p * sorted.size()) - 1);
+    return sorted[index];
+}
+
+// the resampling on its own, the same frames as the model sees
+static double timeResampler(int factor, int nInputs, int nOutputs, int blockSize, int nBlocks) {
+    if (factor <= 1)
+        return 0.0;
+
+    Oversampler oversampler(factor, nInputs, nOutputs, blockSize);
+    std::vector<float> in(blockSize), up(blockSize * factor), out(blockSize);
+    for (int t = 0; t < blockSize; t++)
+        in[t] = 0.5f * std::sin(0.0314f * t);
+
+    auto start = std::chrono::steady_clock::now();
+    for (int n = 0; n < nBlocks; n++) {
+        for (int ch = 0; ch < nInputs; ch++)
+            oversampler.upsample(ch, in.data(), up.data(), blockSize);
+        for (int ch = 0; ch < nOutputs; ch++)
+            oversampler.downsample(ch, up.data(), out.data(), blockSize);
+    }
+    auto end = std::chrono::steady_clock::now();
+    return std::chrono::duration<double, std::nano>(end - start).count() / ((double) nBlocks * blockSize);
+}
+
+static Result run(const Config& c, Model::Backend backend, double seconds, int internalBlock, int oversampling,
+                  Conv1dKernel::Precision precision = Conv1dKernel::Float32, float keep = 1.0f) {
+    const int nInputs = 2, nOutputs = 2;
+
+    resetPeakRSS();
+    Model model(nInputs, nOutputs, c.layers, c.channels, c.kernel, c.dilation, c.bias,
+                c.activation, Model::xavier_normal, 42, c.depthwise);
+    model.setBackend(backend);
+    double sparsity = model.prune(0.0f, keep);
+    model.setPrecision(precision);
+    model.prepareStreaming(internalBlock > 0 ? internalBlock : c.blockSize, 1, internalBlock > 0, oversampling);
+
+    std::vector<float> in(nInputs * c.blockSize), out(nOutputs * c.blockSize);
+    std::vector<float*> outputs(nOutputs);
+
+    // enough blocks for the requested seconds of audio at 48 kHz
+    int nBlocks = std::max(64, (int) (seconds * 48000.0 / c.blockSize));
+    int warmup = std::max(8, nBlocks / 16);
+    std::vector<double> times;
+    times.reserve(nBlocks);
 
-        activation = act; // set the activation function
+    long sample = 0;
+    for (int n = -warmup; n < nBlocks; n++) {
+        for (int ch = 0; ch < nInputs; ch++) {
+            for (int t = 0; t < c.blockSize; t++)
+                in[ch * c.blockSize + t] = 0.5f * std::sin(0.0314f * (sample + t) * (ch + 1));
+        }
+        sample += c.blockSize;
 
-        // now register each convolutional layer
-        for (auto i = 0; i < conv.size(); i++) {
-            register_module("conv"+std::to_string(i), conv[i]);
+        // a host block, split where a fixed block model needs it to be
+        auto start = std::chrono::steady_clock::now();
+        for (int offset = 0, frames = 0; offset < c.blockSize; offset += frames) {
+            frames = std::min(c.blockSize - offset, model.getMaxFrames());
+            for (int ch = 0; ch < nInputs; ch++)
+                std::memcpy(model.getInputPointer(ch), in.data() + ch * c.blockSize + offset, frames * sizeof(float));
+            for (int ch = 0; ch < nOutputs; ch++)
+                outputs[ch] = out.data() + ch * c.blockSize + offset;
+            model.process(frames, outputs.data());
         }
+        auto end = std::chrono::steady_clock::now();
 
-        // and setup the activation functions
-        leakyrelu = torch::nn::LeakyReLU(
-                        torch::nn::LeakyReLUOptions()
-                        .negative_slope(0.2));
+        if (n >= 0)
+            times.push_back(std::chrono::duration<double, std::micro>(end - start).count());
     }
-    // the forward operation
-    torch::Tensor forward(torch::Tensor x) {
-        // we iterate over the convolutions
-        for (auto i = 0; i < conv.size(); i++) {
-            if (i + 1 < conv.size()) {
-                if (activation.compare("ReLU") == 0)
-                    x = torch::relu(conv[i](x));
-                else if (activation.compare("LeakyReLU") == 0)
-                    x = leakyrelu(conv[i](x));
-                else if (activation.compare("Tanh") == 0)
-                    x = torch::tanh(conv[i](x));
-                else if (activation.compare("Sigmoid") == 0)
-                    x = torch::tanh(conv[i](x));
-                else if (activation.compare("ELU") == 0)
-                    x = torch::elu(conv[i](x));
-                else if (activation.compare("SELU") == 0)
-                    x = torch::selu(conv[i](x));
-                else if (activation.compare("GELU") == 0)
-                    x = torch::gelu(conv[i](x));
-                else if (activation.compare("RReLU") == 0)
-                    x = torch::rrelu(conv[i](x));
-                else if (activation.compare("Softplus") == 0)
-                    x = torch::softplus(conv[i](x));
-                else if (activation.compare("Softshrink") == 0)
-                    x = torch::softshrink(conv[i](x));
-                else
-                    x = conv[i](x);
-            }
-            else {
-                x = conv[i](x);
+
+    double total = 0.0;
+    for (auto t : times)
+        total += t;
+    std::sort(times.begin(), times.end());
+
+    Result r;
+    r.config = c;
+    r.receptiveField = model.getReceptiveField();
+    r.nsPerSample = total * 1000.0 / ((double) nBlocks * c.blockSize);
+    r.rtf44 = r.nsPerSample * 44100.0 * 1e-9;
+    r.rtf48 = r.nsPerSample * 48000.0 * 1e-9;
+    r.rtf96 = r.nsPerSample * 96000.0 * 1e-9;
+    r.p50 = percentile(times, 0.50);
+    r.p99 = percentile(times, 0.99);
+    r.max = times.back();
+    r.peakRSS = getCurrentPeakRSS();
+    r.oversampling = model.getOversampling();
+    r.resamplerNsPerSample = timeResampler(r.oversampling, nInputs, nOutputs, c.blockSize, nBlocks);
+    r.precision = model.getPrecision();
+    r.sparsity = sparsity;
+    r.parameters = model.getNumParameters();
+    r.flops = model.getNumFlops();
+    return r;
+}
+
+// SNR in dB of the output of a model after change against the model as built
+static double measureSNR(const Config& c, const std::function<void(Model&)>& change) {
+    const int nInputs = 2, nOutputs = 2, frames = 1 << 15;
+    Model model(nInputs, nOutputs, c.layers, c.channels, c.kernel, c.dilation, c.bias,
+                c.activation, Model::xavier_normal, 42, c.depthwise);
+    model.prepareStreaming(c.blockSize);
+
+    auto x = torch::empty({1, nInputs, frames});
+    float* samples = x.data_ptr<float>();
+    uint32_t state = 1;
+    for (int i = 0; i < nInputs * frames; i++) {
+        int t = i % frames;
+        state = state * 1664525u + 1013904223u;
+        float noise = (state >> 8) / 16777216.0f - 0.5f;
+        samples[i] = 0.4f * std::sin(0.5e-5f * t * t) + 0.1f * noise;
+    }
+
+    auto reference = model.forwardStreaming(x);
+    change(model);
+    model.resetState();
+    auto error = model.forwardStreaming(x) - reference;
+    double signal = reference.pow(2).sum().item<double>(), noise = error.pow(2).sum().item<double>();
+    return noise > 0.0 ? 10.0 * std::log10(signal / noise) : std::numeric_limits<double>::infinity();
+}
+
+static void precisionReport(double seconds) {
+    std::cout << "layers,channels,kernel,activation,precision,snr_db,float32_ns_per_sample,ns_per_sample,speedup" << std::endl;
+    for (auto channels : {16, 32, 64}) {
+        for (int a = Model::Linear; a <= Model::Sine30; a++) {
+            const Config c = {12, channels, 3, 2, a, false, true, 512};
+            double reference = run(c, Model::Native, seconds, 0, 1).nsPerSample;
+            for (auto precision : {Conv1dKernel::Float16, Conv1dKernel::Int8}) {
+                Result r = run(c, Model::Native, seconds, 0, 1, precision);
+                std::cout << c.layers << "," << c.channels << "," << c.kernel << "," << activationNames[a] << ","
+                          << precisionNames[r.precision] << ","
+                          << measureSNR(c, [precision](Model& m) {m.setPrecision(precision);}) << ","
+                          << reference << "," << r.nsPerSample << "," << reference / r.nsPerSample << std::endl;
             }
         }
-        return x;
     }
+}
 
-    void init(std::string initType){
-        for (auto i = 0; i < conv.size(); i++) {
-            if (initType.compare("normal"))
-                torch::nn::init::normal_(conv[i]->weight);
-            else if (initType.compare("uniform"))
-                torch::nn::init::normal_(conv[i]->weight, -0.25, 0.25);
-            else if (initType.compare("xavier_normal"))
-                torch::nn::init::xavier_normal_(conv[i]->weight);
-            else if (initType.compare("xavier_uniform"))
-                torch::nn::init::xavier_uniform_(conv[i]->weight);
-            else if (initType.compare("kaiming_normal"))
-                torch::nn::init::kaiming_normal_(conv[i]->weight);
-            else if (initType.compare("kamming_uniform"))
-                torch::nn::init::kaiming_uniform_(conv[i]->weight);            
+static void pruneReport(double seconds) {
+    std::cout << "layers,channels,kernel,activation,keep,sparsity,snr_db,dense_ns_per_sample,ns_per_sample,cpu_saved" << std::endl;
+    for (auto channels : {16, 32, 64}) {
+        for (int a = Model::Linear; a <= Model::Sine30; a++) {
+            const Config c = {12, channels, 3, 2, a, false, true, 512};
+            double reference = run(c, Model::Native, seconds, 0, 1).nsPerSample;
+            for (auto keep : {0.75f, 0.5f, 0.25f}) {
+                Result r = run(c, Model::Native, seconds, 0, 1, Conv1dKernel::Float32, keep);
+                std::cout << c.layers << "," << c.channels << "," << c.kernel << "," << activationNames[a] << ","
+                          << keep << "," << r.sparsity << "," << measureSNR(c, [keep](Model& m) {m.prune(0.0f, keep);}) << ","
+                          << reference << "," << r.nsPerSample << "," << 1.0 - r.nsPerSample / reference << std::endl;
+            }
         }
     }
+}
 
-    int inChannels, outChannels;
-    std::vector<torch::nn::Conv1d> conv;
+static std::vector<Config> makeSweep(bool full) {
+    const std::vector<int> layers      = {1, 4, 6, 12, 24};
+    const std::vector<int> channels    = {1, 2, 4, 8, 16, 32};
+    const std::vector<int> kernels     = {1, 3, 5, 7, 13, 32};
+    const std::vector<int> dilations   = {1, 2, 3, 4};
+    const std::vector<int> blockSizes  = {32, 64, 128, 256, 512, 1024, 2048, 4096};
+    const Config baseline = {6, 8, 3, 2, Model::Tanh, false, true, 256};
 
-    // activation functions
-    std::string activation;         
-    torch::nn::LeakyReLU leakyrelu;
-};
+    std::vector<Config> sweep;
+    if (full) {
+        for (auto l : layers)
+        for (auto ch : channels)
+        for (auto k : kernels)
+        for (auto d : dilations)
+        for (int a = Model::Linear; a <= Model::Sine30; a++)
+        for (auto dw : {false, true})
+        for (auto b : {false, true})
+        for (auto bs : blockSizes)
+            sweep.push_back({l, ch, k, d, a, dw, b, bs});
+        return sweep;
+    }
 
-int main(){
+    sweep.push_back(baseline);
+    for (auto l : layers)           { Config c = baseline; c.layers = l;      if (l != baseline.layers) sweep.push_back(c); }
+    for (auto ch : channels)        { Config c = baseline; c.channels = ch;   if (ch != baseline.channels) sweep.push_back(c); }
+    for (auto k : kernels)          { Config c = baseline; c.kernel = k;      if (k != baseline.kernel) sweep.push_back(c); }
+    for (auto d : dilations)        { Config c = baseline; c.dilation = d;    if (d != baseline.dilation) sweep.push_back(c); }
+    for (int a = Model::Linear; a <= Model::Sine30; a++)
+                                    { Config c = baseline; c.activation = a;  if (a != baseline.activation) sweep.push_back(c); }
+    { Config c = baseline; c.depthwise = !baseline.depthwise; sweep.push_back(c); }
+    { Config c = baseline; c.bias = !baseline.bias;           sweep.push_back(c); }
+    for (auto bs : blockSizes)      { Config c = baseline; c.blockSize = bs;  if (bs != baseline.blockSize) sweep.push_back(c); }
+    return sweep;
+}
+
+static void printCSVHeader() {
+    std::cout << "backend,layers,channels,kernel,dilation,activation,depthwise,bias,block_size,receptive_field,"
+              << "ns_per_sample,rtf_44k,rtf_48k,rtf_96k,p50_us,p99_us,max_us,peak_rss_kb,"
+              << "oversampling,resampler_ns_per_sample,precision,sparsity,parameters,flops_per_frame" << std::endl;
+}
+
+static void printCSV(const char* backend, const Result& r) {
+    const Config& c = r.config;
+    std::cout << backend << "," << c.layers << "," << c.channels << "," << c.kernel << "," << c.dilation << ","
+              << activationNames[c.activation] << "," << c.depthwise << "," << c.bias << ","
+              << c.blockSize << "," << r.receptiveField << ","
+              << r.nsPerSample << "," << r.rtf44 << "," << r.rtf48 << "," << r.rtf96 << ","
+              << r.p50 << "," << r.p99 << "," << r.max << "," << r.peakRSS << ","
+              << r.oversampling << "," << r.resamplerNsPerSample << "," << precisionNames[r.precision] << "," << r.sparsity << ","
+              << r.parameters << "," << r.flops << std::endl;
+}
+
+static void printJSON(const Result& r, bool first) {
+    const Config& c = r.config;
+    std::cout << (first ? "    " : ",\n    ")
+              << "{\"layers\": " << c.layers << ", \"channels\": " << c.channels
+              << ", \"kernel\": " << c.kernel << ", \"dilation\": " << c.dilation
+              << ", \"activation\": \"" << activationNames[c.activation] << "\""
+              << ", \"depthwise\": " << (c.depthwise ? "true" : "false")
+              << ", \"bias\": " << (c.bias ? "true" : "false")
+              << ", \"block_size\": " << c.blockSize << ", \"receptive_field\": " << r.receptiveField
+              << ", \"ns_per_sample\": " << r.nsPerSample
+              << ", \"rtf_44k\": " << r.rtf44 << ", \"rtf_48k\": " << r.rtf48 << ", \"rtf_96k\": " << r.rtf96
+              << ", \"p50_us\": " << r.p50 << ", \"p99_us\": " << r.p99 << ", \"max_us\": " << r.max
+              << ", \"peak_rss_kb\": " << r.peakRSS
+              << ", \"oversampling\": " << r.oversampling << ", \"resampler_ns_per_sample\": " << r.resamplerNsPerSample
+              << ", \"precision\": \"" << precisionNames[r.precision] << "\", \"sparsity\": " << r.sparsity
+              << ", \"parameters\": " << r.parameters << ", \"flops_per_frame\": " << r.flops
+              << "}" << std::flush;
+}
+
+int main(int argc, char* argv[]){
 
     // don't compute gradients
-    torch::NoGradGuard no_grad_guard; 
-
-    // define the model config
-    int nInputs     = 1;
-    int nOutputs    = 2;
-    int nLayers     = 6;
-    int nChannels   = 8;
-    int kernelWidth = 3;
-    bool bias       = false;
-    std::string act = "Softshrink";
-    float dilations [6] = {1,2,4,8,16,32};
-
-    // build the model
-    Model model(nInputs, 
-                nOutputs, 
-                nLayers, 
-                nChannels, 
-                kernelWidth, 
-                bias, 
-                act,
-                dilations);
-    
-    // pass through a random tensor
-    auto in = torch::rand({1,1,44100});
-    auto out = model.forward(in);
-
-    for (auto i = 0; i < out.dim(); i++){
-        std::cout << out.size(i) << std::endl;
+    torch::NoGradGuard no_grad_guard;
+    torch::set_num_threads(1);
+
+    std::string format = "csv";
+    bool full = false;
+    double seconds = 2.0;
+    Model::Backend backend = Model::Native;
+    int internalBlock = 0;
+    int oversampling = 1;
+    Conv1dKernel::Precision precision = Conv1dKernel::Float32;
+    float keep = 1.0f;
+    bool report = false, pruning = false;
+
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--format" && i + 1 < argc)
+            format = argv[++i];
+        else if (arg == "--full")
+            full = true;
+        else if (arg == "--seconds" && i + 1 < argc)
+            seconds = std::atof(argv[++i]);
+        else if (arg == "--backend" && i + 1 < argc)
+            backend = std::string(argv[++i]) == "torch" ? Model::Torch : Model::Native;
+        else if (arg == "--internal-block" && i + 1 < argc)
+            internalBlock = std::atoi(argv[++i]);
+        else if (arg == "--oversampling" && i + 1 < argc)
+            oversampling = std::atoi(argv[++i]);
+        else if (arg == "--precision" && i + 1 < argc) {
+            std::string name = argv[++i];
+            precision = name == "int8" ? Conv1dKernel::Int8 : name == "float16" ? Conv1dKernel::Float16 : Conv1dKernel::Float32;
+        }
+        else if (arg == "--prune" && i + 1 < argc)
+            keep = (float) std::atof(argv[++i]);
+        else if (arg == "--precision-report")
+            report = true;
+        else if (arg == "--prune-report")
+            pruning = true;
+        else {
+            std::cerr << "usage: ronnlib [--format csv|json] [--full] [--backend native|torch] [--seconds s] "
+                      << "[--internal-block n] [--oversampling 2|4|8] [--precision float32|float16|int8] "
+                      << "[--prune keep] [--precision-report|--prune-report]" << std::endl;
+            return 1;
+        }
+    }
+
+    if (report || pruning) {
+        if (report)
+            precisionReport(seconds);
+        else
+            pruneReport(seconds);
+        return 0;
     }
 
-    model.init("xavier_normal");
+    auto sweep = makeSweep(full);
+    const char* isa = backend == Model::Torch ? "torch" : Conv1dKernel::getISAName(Conv1dKernel::detectISA());
 
-}
\ No newline at end of file
+    if (format == "json") {
+        std::cout << "{\n  \"backend\": \"" << isa << "\",\n  \"results\": [\n";
+        for (size_t i = 0; i < sweep.size(); i++)
+            printJSON(run(sweep[i], backend, seconds, internalBlock, oversampling, precision, keep), i == 0);
+        std::cout << "\n  ]\n}" << std::endl;
+    }
+    else {
+        printCSVHeader();
+        for (auto& c : sweep)
+            printCSV(isa, run(c, backend, seconds, internalBlock, oversampling, precision, keep));
+    }
+    return 0;
+}